@@ -1,4 +1,6 @@
 #!/usr/bin/env python
+# roibin_test -c auto applies this model with the frame dims, maxPeaks, binning:shape and roibin:roi_size
+# of the actual run (see include/memory_model.h); this script is kept for planning allocations
 
 z1=3 #sz mem multiple estimate
 z2=3 #fpzip mem multiple estimate
@@ -0,0 +1,55 @@
+#ifndef BUFFER_POOL_H_J6TNC4RY
+#define BUFFER_POOL_H_J6TNC4RY
+#include <libpressio_ext/cpp/data.h>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * counters for the allocations made by a buffer_pool
+ */
+struct buffer_pool_stats {
+  size_t bytes_allocated = 0;
+  size_t bytes_reused = 0;
+  size_t allocations = 0;
+  size_t reuses = 0;
+};
+
+/**
+ * recycles large, 64-byte aligned buffers between chunks
+ *
+ * buffers are handed out as non-owning pressio_data views and stay owned by the pool; a released
+ * buffer is handed out again for a later request that fits and needs at least half of it.  When huge_pages is set, buffers are
+ * mapped with mmap and advised to use transparent huge pages.
+ */
+class buffer_pool {
+ public:
+  explicit buffer_pool(bool huge_pages = false);
+  ~buffer_pool();
+  buffer_pool(buffer_pool const&) = delete;
+  buffer_pool& operator=(buffer_pool const&) = delete;
+
+  /** \returns a non-owning view with the requested type and dimensions */
+  pressio_data acquire(pressio_dtype dtype, std::vector<size_t> const& dims);
+  /** returns a buffer previously returned by acquire to the pool; views of it must no longer be used */
+  void release(void const* ptr);
+  /** \returns true if ptr is the start of a buffer handed out by this pool */
+  bool owns(void const* ptr) const;
+
+  buffer_pool_stats stats() const;
+
+ private:
+  void* allocate(size_t bytes);
+  void deallocate(void* ptr, size_t bytes);
+
+  bool huge_pages;
+  mutable std::mutex mtx;
+  std::multimap<size_t, void*> free_buffers;
+  std::unordered_map<void const*, size_t> in_use;
+  buffer_pool_stats counters;
+};
+
+#endif /* end of include guard: BUFFER_POOL_H_J6TNC4RY */
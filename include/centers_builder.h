@@ -0,0 +1,60 @@
+#ifndef CENTERS_BUILDER_H_P3KD8ZQA
+#define CENTERS_BUILDER_H_P3KD8ZQA
+#include <libpressio_ext/cpp/data.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * counts of the peaks seen by centers_builder::build
+ */
+struct centers_stats {
+  size_t peaks = 0;
+  // peaks outside of the frame that were moved to the nearest pixel of the frame
+  size_t clamped = 0;
+  // peaks with a NaN coordinate that were skipped
+  size_t dropped = 0;
+
+  centers_stats& operator+=(centers_stats const& rhs) {
+    peaks += rhs.peaks;
+    clamped += rhs.clamped;
+    dropped += rhs.dropped;
+    return *this;
+  }
+};
+
+/**
+ * builds the {3, peaks} roibin:centers array (x, y, event) from the peak tables of a chunk
+ *
+ * the coordinates are truncated to integers using AVX-512 or AVX2 when the CPU supports them,
+ * clamped to the frame, and written into a buffer that is reused across calls
+ */
+class centers_builder {
+ public:
+  /**
+   * \param frame_dims the extent of the x and y dimensions of a frame in libpressio order
+   */
+  explicit centers_builder(std::array<size_t, 2> frame_dims);
+
+  /**
+   * \param npeaks the number of peaks for each of the events
+   * \param events the number of events in the chunk
+   * \param posx the x coordinate of each peak
+   * \param posy the y coordinate of each peak
+   * \param row_stride distance between the rows of consecutive events; 0 if rows are packed back to back
+   * \param centers output; its allocation is reused if it is large enough
+   */
+  centers_stats build(int64_t const* npeaks, size_t events, double const* posx, double const* posy,
+                      size_t row_stride, pressio_data& centers);
+
+  /** the name of the conversion kernel selected for this CPU */
+  static const char* kernel_name();
+
+ private:
+  std::array<uint64_t, 2> limits;
+  std::vector<uint64_t> x_scratch, y_scratch;
+};
+
+#endif /* end of include guard: CENTERS_BUILDER_H_P3KD8ZQA */
@@ -0,0 +1,100 @@
+#ifndef COMPRESSED_ARCHIVE_H_T4MW9QEH
+#define COMPRESSED_ARCHIVE_H_T4MW9QEH
+#include <hdf5.h>
+#include <libpressio_ext/cpp/data.h>
+#include <mpi.h>
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "io_profile.h"
+
+/**
+ * one row of the archive index: the compressed stream of events [first_event, first_event+n_events)
+ * is stored in bytes [offset, offset+length) of the compressed dataset
+ */
+struct archive_entry {
+  uint64_t first_event = 0;
+  uint64_t n_events = 0;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  uint64_t config_hash = 0;
+};
+
+/** \returns the 64-bit FNV-1a hash of a compressor configuration */
+uint64_t config_hash(std::string const& config);
+
+/**
+ * an HDF5 archive of compressed chunks
+ *
+ * the file holds /compressed, a 1d uint8 dataset of the concatenated compressed streams, and /index,
+ * an {entries, 5} uint64 dataset of archive_entry rows.  The compressor configuration is stored in the
+ * "config" attribute of the root group.
+ *
+ * construction, append (when lockstep), finish and destruction are collective over comm.  Each
+ * collective write places the streams of the ranks back to back in rank order using offsets from an
+ * MPI_Exscan.  When the ranks do not advance in lockstep, extending the datasets cannot be collective, so
+ * only rank 0 of comm opens the file: the other ranks send it their streams with non-blocking MPI as they
+ * append them, and it appends them as they arrive whenever append, progress, or finish is called.
+ */
+class compressed_archive {
+ public:
+  compressed_archive(std::string const& path, std::string const& config, MPI_Comm comm, bool lockstep,
+                     io_profile const& profile = io_profile{});
+  ~compressed_archive();
+  compressed_archive(compressed_archive const&) = delete;
+  compressed_archive& operator=(compressed_archive const&) = delete;
+
+  /** appends the compressed stream of n_events events starting at first_event; n_events may be 0 */
+  void append(uint64_t first_event, uint64_t n_events, pressio_data const& compressed);
+  /**
+   * appends several streams at once, such as the parts of a chunk compressed by different threads; stream k
+   * holds n_events[k] events starting at first_events[k].  Collective like append.
+   */
+  void append(std::vector<uint64_t> const& first_events, std::vector<uint64_t> const& n_events,
+              std::vector<pressio_data const*> const& streams);
+  /** completes finished sends and appends the streams that have arrived */
+  void progress();
+  /** waits for the streams of every rank to be written */
+  void finish();
+
+  /** total bytes of compressed streams in the archive */
+  uint64_t size_in_bytes() const { return archive_bytes; }
+  uint64_t num_entries() const { return archive_entries; }
+
+ private:
+  struct pending_send {
+    MPI_Request requests[3];
+    // the number of entries and bytes
+    uint64_t header[2];
+    std::vector<archive_entry> entries;
+    std::vector<uint8_t> bytes;
+  };
+
+  void create(std::string const& path, std::string const& config, hid_t fapl);
+  void write_entries(std::vector<archive_entry>& entries, void const* bytes, uint64_t length);
+  void append_entries(std::vector<archive_entry>& entries, void const* bytes, uint64_t length);
+  void write_serial(std::vector<archive_entry>& entries, void const* bytes, uint64_t length);
+  bool receive(bool wait);
+
+  MPI_Comm comm;
+  int rank = 0;
+  int size = 1;
+  bool lockstep;
+  uint64_t hash;
+  hid_t file = H5I_INVALID_HID;
+  hid_t bytes_dset = H5I_INVALID_HID;
+  hid_t index_dset = H5I_INVALID_HID;
+  uint64_t archive_bytes = 0;
+  uint64_t archive_entries = 0;
+
+  std::list<pending_send> sends;
+  uint64_t done_header[2];
+  int senders_done = 0;
+  std::vector<archive_entry> received_entries;
+  std::vector<uint8_t> received_bytes;
+};
+
+#endif /* end of include guard: COMPRESSED_ARCHIVE_H_T4MW9QEH */
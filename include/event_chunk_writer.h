@@ -0,0 +1,85 @@
+#ifndef EVENT_CHUNK_WRITER_H_H9WQ4ZJC
+#define EVENT_CHUNK_WRITER_H_H9WQ4ZJC
+#include <hdf5.h>
+#include <libpressio_ext/cpp/data.h>
+#include <mpi.h>
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "io_profile.h"
+
+/**
+ * counters for the chunks written by the writing rank and the time every rank spent on the funnel
+ */
+struct event_chunk_writer_stats {
+  size_t writes = 0;
+  size_t bytes_written = 0;
+  // in H5Dwrite_chunk on the writing rank
+  double write_seconds = 0;
+  // in finish, waiting for the other ranks' chunks to be sent and written
+  double finish_seconds = 0;
+};
+
+/**
+ * writes a CXI-shaped file whose /entry_1/data_1/data has one chunk per event compressed with the
+ * roibin HDF5 filter
+ *
+ * chunks are encoded with roibin_h5filter_encode and written as-is with H5Dwrite_chunk, so readers
+ * with the filter plugin on HDF5_PLUGIN_PATH decompress only the events they read.  The compressor
+ * configuration is stored once in the cd_values of the filter.  Writing a
+ * variable-size chunk allocates file space and updates the chunk index, which parallel HDF5 only
+ * permits collectively, so only rank 0 of comm opens the file: the other ranks send it their encoded
+ * chunks with non-blocking MPI and it writes them whenever write_event, progress, or finish is called.
+ *
+ * construction and finish() are collective over comm
+ */
+class event_chunk_writer {
+ public:
+  /**
+   * \param dims the hdf5 dimensions of the data, {events, y, x}
+   * \param config the json configuration of the compressor that compressed the chunks
+   */
+  event_chunk_writer(std::string const& path, std::vector<hsize_t> const& dims, std::string const& config,
+                     MPI_Comm comm, io_profile const& profile = io_profile{});
+  ~event_chunk_writer();
+  event_chunk_writer(event_chunk_writer const&) = delete;
+  event_chunk_writer& operator=(event_chunk_writer const&) = delete;
+
+  /** writes, or sends to the writing rank, the encoded chunk of a single event */
+  void write_event(hsize_t event, pressio_data const& chunk);
+  /** completes finished sends and writes the chunks that have arrived */
+  void progress();
+  /** waits for the chunks of every rank to be written */
+  void finish();
+
+  event_chunk_writer_stats stats() const { return counters; }
+
+ private:
+  struct pending_send {
+    MPI_Request requests[2];
+    uint64_t header[2];
+    std::vector<char> chunk;
+  };
+
+  bool is_writer() const { return rank == 0; }
+  bool receive(bool wait);
+  void write(hsize_t event, void const* chunk, size_t bytes);
+
+  MPI_Comm comm;
+  int rank = 0;
+  int size = 1;
+  hid_t file = H5I_INVALID_HID;
+  hid_t dset = H5I_INVALID_HID;
+  size_t dims = 0;
+
+  std::list<pending_send> sends;
+  uint64_t done_header[2];
+  int senders_done = 0;
+  std::vector<char> received;
+  event_chunk_writer_stats counters;
+};
+
+#endif /* end of include guard: EVENT_CHUNK_WRITER_H_H9WQ4ZJC */
@@ -1,3 +1,9 @@
+#ifndef FILE_HELPERS_H_C6PJ2RNV
+#define FILE_HELPERS_H_C6PJ2RNV
+#include <sys/types.h>
+
+#include <cstdint>
+#include <exception>
 #include <string>
 
 class posix_error : public std::exception {
@@ -10,4 +16,54 @@ class posix_error : public std::exception {
   std::string full_msg;
 };
 
-void copy_file(std::string const& source, std::string const& dest);
+/**
+ * how copy_file copies a file
+ *
+ * automatic tries a reflink and falls back to copy_file_range, which itself falls back to sendfile
+ * where the kernel or filesystem does not support it
+ */
+enum class copy_strategy { automatic, reflink, copy_file_range, sendfile };
+
+/** \throws std::runtime_error for an unknown strategy */
+copy_strategy parse_copy_strategy(std::string const& name);
+const char* copy_strategy_name(copy_strategy strategy);
+
+/**
+ * what a copy did and how long it took
+ */
+struct copy_stats {
+  // the strategy that was actually used
+  copy_strategy strategy = copy_strategy::automatic;
+  uint64_t bytes = 0;
+  double seconds = 0;
+
+  double bandwidth_GBps() const { return seconds > 0 ? bytes / seconds * 1e-9 : 0; }
+};
+
+/** \returns the size of the file at path */
+uint64_t file_size(std::string const& path);
+
+/**
+ * creates dest as a reflink (FICLONE) of source
+ *
+ * \returns false if the filesystem cannot share the extents of the two files
+ */
+bool reflink_file(std::string const& source, std::string const& dest);
+
+/** creates or truncates the file at path and sets its size */
+void create_file(std::string const& path, uint64_t size);
+
+/**
+ * copies the bytes [offset, offset+length) of source into the same range of dest, which must exist
+ *
+ * the range is split between threads and synced to disk.  strategy must be copy_file_range or sendfile; copy_file_range
+ * falls back to sendfile if it is not supported between the two files.
+ */
+copy_stats copy_file_part(std::string const& source, std::string const& dest, uint64_t offset, uint64_t length,
+                          copy_strategy strategy = copy_strategy::copy_file_range, unsigned threads = 1);
+
+/** copies source to dest, replacing dest */
+copy_stats copy_file(std::string const& source, std::string const& dest,
+                     copy_strategy strategy = copy_strategy::automatic, unsigned threads = 1);
+
+#endif /* end of include guard: FILE_HELPERS_H_C6PJ2RNV */
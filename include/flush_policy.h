@@ -0,0 +1,46 @@
+#ifndef FLUSH_POLICY_H_B8KQ3TZN
+#define FLUSH_POLICY_H_B8KQ3TZN
+#include <mpi.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/**
+ * decides after which chunk writes the output file is flushed
+ *
+ * policies are
+ *   always       flush after every chunk (the historic behavior)
+ *   close        never flush; the file is flushed when it is closed
+ *   chunks:N     flush after every N chunks
+ *   seconds:T    flush once at least T seconds passed since the last flush
+ *   signal       flush after the next chunk once any rank receives SIGUSR1
+ *
+ * H5Fflush is collective, so due() must be called on every rank after every chunk; the seconds and
+ * signal policies agree on the decision with an MPI_Allreduce.
+ */
+class flush_policy {
+ public:
+  enum class kind { always, close, chunks, seconds, signal };
+
+  /** \throws std::runtime_error for an unknown policy */
+  static flush_policy parse(std::string const& spec);
+
+  /** \returns true if the file should be flushed after the chunk that was just written; collective */
+  bool due(MPI_Comm comm);
+
+  kind type() const { return policy; }
+  std::string const& name() const { return spec; }
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  std::string spec;
+  kind policy = kind::always;
+  size_t every_chunks = 1;
+  double every_seconds = 0;
+  size_t chunks_since_flush = 0;
+  clock::time_point last_flush = clock::now();
+};
+
+#endif /* end of include guard: FLUSH_POLICY_H_B8KQ3TZN */
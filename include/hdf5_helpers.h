@@ -2,8 +2,14 @@
 #define HDF5_HELPERS_H_NME0K8QT
 #include <hdf5.h>
 #include <libpressio_ext/cpp/data.h>
+#include <mpi.h>
 
+#include <algorithm>
+#include <iterator>
 #include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 #include "cleanup.h"
 
@@ -71,42 +77,200 @@ T get_attribute(hid_t file, const char* dset_loc, const char* attrib_loc) {
   return attr;
 }
 
+/**
+ * the events copied by copy(): count events starting at first, taking every stride-th event
+ */
+struct event_selection {
+  hsize_t first = 0;
+  hsize_t count = 0;
+  hsize_t stride = 1;
+};
+
+/**
+ * copies the selected events of data to a new dataset dset_name of output_file
+ *
+ * the events are streamed in blocks of at most block_events events, so only one block is in memory
+ * at a time, and the ranks of comm copy disjoint blocks.  Every rank of comm MUST call this with the same
+ * arguments since creating the dataset and writing it (which HDF5 requires when dcpl has filters) are collective.
+ */
 template <class T>
-void copy(h5dset const& data, std::vector<hsize_t> const& count, hid_t dcpl, hid_t output_file,
-          const char* dset_name) {
-  {
-    hid_t output_data_dataspace = check_hdf5(H5Screate_simple(count.size(), count.data(), nullptr));
-    cleanup output_space_cleanup([&] { H5Sclose(output_data_dataspace); });
-
-    std::vector<hsize_t> start(data.get_dims_hsize().size(), 0);
-    hid_t file_space = check_hdf5(H5Scopy(data.space));
-    cleanup cleanup_filespace([=] { H5Sclose(file_space); });
-    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start.data(),
-                        /*stride*/ nullptr, count.data(),
-                        /*block*/ nullptr);
-
-    size_t num_elements =
-        std::accumulate(count.begin(), count.end(), hsize_t{1}, std::multiplies<>{});
-    std::vector<T> work_data(num_elements);
-    check_hdf5(H5Dread(data.dset, get_hdf5_native_type<T>(), H5S_ALL, file_space,
-                       /*xfer*/ H5P_DEFAULT, work_data.data()));
-
-    hid_t lcpl = check_hdf5(H5Pcreate(H5P_LINK_CREATE));
-    cleanup cleanup_lcpl([&] { H5Pclose(lcpl); });
-    check_hdf5(H5Pset_create_intermediate_group(lcpl, 1));
-
-    hid_t output_data_dset =
-        check_hdf5(H5Dcreate(output_file, dset_name, get_hdf5_native_type<T>(),
-                             output_data_dataspace, lcpl, dcpl, /*dapl*/ H5P_DEFAULT));
-    check_hdf5(H5Dwrite(output_data_dset, get_hdf5_native_type<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                        work_data.data()));
+void copy(h5dset const& data, event_selection const& events, size_t block_events, hid_t dcpl, hid_t output_file,
+          const char* dset_name, MPI_Comm comm) {
+  auto const dims = data.get_dims_hsize();
+  if (events.count == 0 || events.stride == 0 || events.first + (events.count - 1) * events.stride >= dims.front()) {
+    throw std::runtime_error(std::string("event selection is out of range for ") + dset_name);
+  }
+  auto output_dims = dims;
+  output_dims.front() = events.count;
+  hid_t output_space = check_hdf5(H5Screate_simple(output_dims.size(), output_dims.data(), nullptr));
+  cleanup cleanup_output_space([=] { H5Sclose(output_space); });
+
+  hid_t lcpl = check_hdf5(H5Pcreate(H5P_LINK_CREATE));
+  cleanup cleanup_lcpl([=] { H5Pclose(lcpl); });
+  check_hdf5(H5Pset_create_intermediate_group(lcpl, 1));
+  hid_t output_dset = check_hdf5(H5Dcreate(output_file, dset_name, get_hdf5_native_type<T>(), output_space, lcpl, dcpl,
+                                           /*dapl*/ H5P_DEFAULT));
+  cleanup cleanup_output_dset([=] { H5Dclose(output_dset); });
+
+  hid_t xfer = check_hdf5(H5Pcreate(H5P_DATASET_XFER));
+  cleanup cleanup_xfer([=] { H5Pclose(xfer); });
+  check_hdf5(H5Pset_dxpl_mpio(xfer, H5FD_MPIO_COLLECTIVE));
+
+  size_t const row_elements =
+      std::accumulate(std::next(dims.begin()), dims.end(), hsize_t{1}, std::multiplies<>{});
+  block_events = std::max<size_t>(1, std::min<size_t>(block_events, events.count));
+  std::vector<T> block(block_events * row_elements);
+
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  size_t const blocks = (events.count + block_events - 1) / block_events;
+  size_t const rounds = (blocks + size - 1) / size;
+  // every rank takes part in every round so the collective writes match, writing nothing once out of blocks
+  for (size_t round = 0; round < rounds; ++round) {
+    size_t const id = round * size + rank;
+    hsize_t const begin = id * block_events;
+    hsize_t const n = id < blocks ? std::min<hsize_t>(block_events, events.count - begin) : 0;
+
+    auto block_dims = dims;
+    block_dims.front() = std::max<hsize_t>(n, 1);
+    hid_t mem_space = check_hdf5(H5Screate_simple(block_dims.size(), block_dims.data(), nullptr));
+    cleanup cleanup_mem_space([=] { H5Sclose(mem_space); });
+    hid_t write_space = check_hdf5(H5Scopy(output_space));
+    cleanup cleanup_write_space([=] { H5Sclose(write_space); });
+
+    if (n) {
+      std::vector<hsize_t> start(dims.size(), 0), stride(dims.size(), 1), count = dims;
+      start.front() = events.first + begin * events.stride;
+      stride.front() = events.stride;
+      count.front() = n;
+      hid_t read_space = check_hdf5(H5Scopy(data.space));
+      cleanup cleanup_read_space([=] { H5Sclose(read_space); });
+      check_hdf5(H5Sselect_hyperslab(read_space, H5S_SELECT_SET, start.data(), stride.data(), count.data(),
+                                     /*block*/ nullptr));
+      check_hdf5(H5Dread(data.dset, get_hdf5_native_type<T>(), mem_space, read_space, /*xfer*/ H5P_DEFAULT,
+                         block.data()));
+
+      start.front() = begin;
+      check_hdf5(H5Sselect_hyperslab(write_space, H5S_SELECT_SET, start.data(), /*stride*/ nullptr, count.data(),
+                                     /*block*/ nullptr));
+    } else {
+      check_hdf5(H5Sselect_none(mem_space));
+      check_hdf5(H5Sselect_none(write_space));
+    }
+    check_hdf5(H5Dwrite(output_dset, get_hdf5_native_type<T>(), mem_space, write_space, xfer, block.data()));
   }
 }
 
+/**
+ * owns an HDF5 identifier and closes it with close
+ *
+ * unlike cleanup this does not allocate, so it is used on the per-chunk transfer path
+ */
+class h5handle {
+ public:
+  h5handle() = default;
+  h5handle(hid_t id, herr_t (*close)(hid_t)) : id(id), close(close) {}
+  ~h5handle() { reset(); }
+  h5handle(h5handle const&) = delete;
+  h5handle& operator=(h5handle const&) = delete;
+  h5handle(h5handle&& rhs) noexcept
+      : id(std::exchange(rhs.id, H5I_INVALID_HID)), close(std::exchange(rhs.close, nullptr)) {}
+  h5handle& operator=(h5handle&& rhs) noexcept {
+    if (&rhs == this) return *this;
+    reset();
+    id = std::exchange(rhs.id, H5I_INVALID_HID);
+    close = std::exchange(rhs.close, nullptr);
+    return *this;
+  }
+
+  hid_t get() const { return id; }
+  explicit operator bool() const { return id != H5I_INVALID_HID; }
+  void reset() {
+    if (close && id != H5I_INVALID_HID) close(id);
+    id = H5I_INVALID_HID;
+    close = nullptr;
+  }
+
+ private:
+  hid_t id = H5I_INVALID_HID;
+  herr_t (*close)(hid_t) = nullptr;
+};
+
+/**
+ * transfers hyperslabs between memory and a single dataset, reusing the file and memory dataspaces
+ * and the transfer property list between calls
+ *
+ * the dataset must outlive the transfer
+ */
+class h5transfer {
+ public:
+  explicit h5transfer(h5dset const& dset, H5FD_mpio_xfer_t xfer_mode = H5FD_MPIO_COLLECTIVE);
+
+  void read(std::vector<hsize_t> const& start, std::vector<hsize_t> const& count, pressio_data& data,
+            size_t work_items, bool debug = false);
+  void write(std::vector<hsize_t> const& start, std::vector<hsize_t> const& count, pressio_data& data,
+             size_t work_items, bool debug = false);
+
+ private:
+  void select(std::vector<hsize_t> const& start, std::vector<hsize_t> const& count, pressio_data& data,
+              size_t work_items, const char* op);
+
+  h5dset const* dset;
+  h5handle file_space, mem_space, xfer;
+  std::vector<hsize_t> mem_dims;
+};
+
 void read(h5dset const& dset, std::vector<hsize_t> const& start, std::vector<hsize_t> const& count,
-          pressio_data& data, size_t work_items, bool debug=false);
+          pressio_data& data, size_t work_items, bool debug=false,
+          H5FD_mpio_xfer_t xfer_mode=H5FD_MPIO_COLLECTIVE);
 
 void write(h5dset const& dset, std::vector<hsize_t> const& start, std::vector<hsize_t> const& count,
-           pressio_data& data, size_t work_items, bool debug=false);
+           pressio_data& data, size_t work_items, bool debug=false,
+           H5FD_mpio_xfer_t xfer_mode=H5FD_MPIO_COLLECTIVE);
+
+/**
+ * reads the first lengths[k] columns of rows first_row+k of a 2d dataset for k in [0, rows)
+ * into data with the rows packed back to back
+ *
+ * \returns the number of bytes read
+ */
+size_t read_row_prefixes(h5dset const& dset, hsize_t first_row, int64_t const* lengths, size_t rows,
+                         pressio_data& data, H5FD_mpio_xfer_t xfer_mode=H5FD_MPIO_COLLECTIVE);
+
+/**
+ * the storage layout of a dataset
+ */
+struct h5layout {
+  bool chunked = false;
+  // the extent of a chunk in hdf5 order; empty unless chunked
+  std::vector<hsize_t> chunk_dims;
+  // the number of filters, such as compression, applied to each chunk
+  int filters = 0;
+};
+
+h5layout get_layout(h5dset const& dset);
+
+/**
+ * reads rows [first_row, first_row+rows) of a dataset chunked along its first dimension by copying
+ * whole chunks with H5Dread_chunk, bypassing the filter pipeline and the hyperslab selection
+ *
+ * the reads are independent.  \returns false without reading if the dataset is filtered, is not stored
+ * as the type of data, its chunks do not span every other dimension, the rows do not cover whole chunks,
+ * or a chunk is not allocated, in which case the caller should fall back to read()
+ */
+bool read_chunks_direct(h5dset const& dset, h5layout const& layout, hsize_t first_row, size_t rows,
+                        pressio_data& data);
+
+/**
+ * creates dest as a small HDF5 file with the same layout as source without copying its data
+ *
+ * the dataset at data_loc is created empty with the type, shape, and creation properties of the
+ * source dataset less its filters, so that it can be written independently.  Its parent groups are
+ * created with their attributes, as are soft links to it and the groups that hold them, soft links
+ * among the children of created groups are recreated in dest, and every other object is reached
+ * through an external link to the same path in source
+ */
+void create_linked_file(std::string const& source, std::string const& dest, const char* data_loc);
 
 #endif /* end of include guard: HDF5_HELPERS_H_NME0K8QT */
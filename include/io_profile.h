@@ -0,0 +1,51 @@
+#ifndef IO_PROFILE_H_M3QF7VXA
+#define IO_PROFILE_H_M3QF7VXA
+#include <hdf5.h>
+#include <mpi.h>
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+/**
+ * MPI-IO and HDF5 tuning for a filesystem, loaded from a json file such as
+ *
+ *   {
+ *     "name": "lustre",
+ *     "mpi_hints": {"cb_nodes": 8, "cb_buffer_size": 16777216, "romio_cb_read": "enable", "striping_factor": 16},
+ *     "transfer": {"default": "collective", "/entry_1/result_1/nPeaks": "independent"},
+ *     "alignment": {"threshold": 1048576, "alignment": 4194304},
+ *     "metadata_cache_bytes": 33554432,
+ *     "chunk_cache": {"bytes": 67108864, "slots": 12421, "w0": 0.75}
+ *   }
+ *
+ * every field is optional; the default profile leaves HDF5 and MPI-IO at their defaults with collective
+ * transfers.  Hints and alignment that only affect file creation apply to files created with the fapl.
+ */
+struct io_profile {
+  std::string name = "default";
+  std::map<std::string, std::string> mpi_hints;
+  // dataset path or "default" to "collective" or "independent"
+  std::map<std::string, std::string> transfer;
+  hsize_t alignment_threshold = 1;
+  hsize_t alignment = 1;
+  size_t metadata_cache_bytes = 0;
+  size_t chunk_cache_bytes = 0;
+  size_t chunk_cache_slots = 0;
+  double chunk_cache_w0 = 0.75;
+  // the profile as loaded, echoed into the run summary
+  std::string json = "{}";
+
+  /** \throws std::runtime_error if the file cannot be read or a field is invalid */
+  static io_profile load(std::string const& path);
+
+  /** sets the MPI-IO driver with the hints of the profile, the alignment, and the cache sizes on fapl */
+  void apply(hid_t fapl, MPI_Comm comm) const;
+  /** sets only the alignment and the cache sizes on fapl, for files opened by a single rank */
+  void apply_serial(hid_t fapl) const;
+
+  /** \returns the transfer mode for the dataset at loc */
+  H5FD_mpio_xfer_t transfer_mode(std::string const& loc) const;
+};
+
+#endif /* end of include guard: IO_PROFILE_H_M3QF7VXA */
@@ -0,0 +1,52 @@
+#ifndef MEMORY_MODEL_H_K9RM2ZTA
+#define MEMORY_MODEL_H_K9RM2ZTA
+#include <libpressio_ext/cpp/options.h>
+
+#include <cstddef>
+
+/**
+ * predicts the memory a worker rank needs for a chunk of events, following estimate_mem.py
+ *
+ * for each event in flight a rank holds the frame, the compressed buffer offered to the compressor, the
+ * decompressed frame (with -o), the binned background compressor's working memory (background_factor times the
+ * binned frame, twice), the ROI compressor's input and working memory (1 + roi_factor times one ROI per peak),
+ * and the peak positions and centers.
+ */
+struct memory_model {
+  // memory multiples of the background (SZ) and ROI (fpzip) compressors relative to their input
+  double background_factor = 3;
+  double roi_factor = 3;
+  size_t bin_elements = 2 * 2;
+  size_t roi_elements = 17 * 17;
+
+  size_t frame_elements = 0;
+  size_t max_peaks = 0;
+  size_t element_size = sizeof(float);
+  // chunks whose frames are held at once (the pipeline depth, or the ring slots with reader ranks)
+  size_t frame_buffers = 1;
+  // chunks being compressed or written at once
+  size_t chunks_in_flight = 1;
+  bool decompress = false;
+  // memory of the node shared by its ranks, such as the peak cache
+  size_t node_bytes = 0;
+
+  /** reads binning:shape and roibin:roi_size from the compressor options, keeping the defaults if unset */
+  void set_options(pressio_options const& options);
+
+  size_t bytes_per_event() const;
+  /** \returns the predicted bytes one of ranks ranks of a node needs for chunks of chunk_size events */
+  size_t bytes_per_rank(size_t chunk_size, size_t ranks) const;
+  /** \returns the largest chunk size whose prediction for each of ranks ranks fits in node_budget, or 0 */
+  size_t chunk_size_for(size_t node_budget, size_t ranks) const;
+};
+
+/**
+ * \returns the memory available to this process: MemAvailable from /proc/meminfo, limited by the remaining
+ * room under the memory limits (v2 or v1) of the cgroup of this process from /proc/self/cgroup and its ancestors
+ */
+size_t available_memory();
+
+/** \returns the peak resident set size of this process in bytes */
+size_t peak_rss();
+
+#endif /* end of include guard: MEMORY_MODEL_H_K9RM2ZTA */
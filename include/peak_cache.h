@@ -0,0 +1,55 @@
+#ifndef PEAK_CACHE_H_W5HN0JQE
+#define PEAK_CACHE_H_W5HN0JQE
+#include <mpi.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hdf5_helpers.h"
+
+/**
+ * the nPeaks, peakXPosRaw and peakYPosRaw tables for every event of a run, stored once per node in an
+ * MPI shared-memory window
+ *
+ * rank 0 of node_comm loads the tables with independent reads; every rank of node_comm then reads
+ * them in place without copying.  Construction and destruction are collective over node_comm, which
+ * must only contain ranks that share memory.
+ *
+ * when compact is set, only the first nPeaks positions of each event are loaded and stored back to
+ * back (CSR) instead of the padded maxPeaks columns
+ */
+class peak_cache {
+ public:
+  peak_cache(h5dset const& npeaks, h5dset const& posx, h5dset const& posy, MPI_Comm node_comm,
+             bool compact = false);
+  ~peak_cache();
+  peak_cache(peak_cache const&) = delete;
+  peak_cache& operator=(peak_cache const&) = delete;
+
+  size_t num_events() const { return events; }
+  size_t max_peaks() const { return peaks; }
+  size_t size_in_bytes() const { return bytes; }
+  /** bytes read from the file by this rank to fill the cache */
+  size_t bytes_read() const { return loaded_bytes; }
+  bool compacted() const { return offsets_ptr != nullptr; }
+
+  /**
+   * non-owning views of the rows for events [id, id+work_items) in the layout read() produces, or
+   * read_row_prefixes() produces if the cache is compacted
+   */
+  pressio_data npeaks(size_t id, size_t work_items) const;
+  pressio_data posx(size_t id, size_t work_items) const;
+  pressio_data posy(size_t id, size_t work_items) const;
+
+ private:
+  pressio_data positions(double* base, size_t id, size_t work_items) const;
+
+  size_t events = 0, peaks = 0, bytes = 0, loaded_bytes = 0;
+  int64_t* npeaks_ptr = nullptr;
+  uint64_t* offsets_ptr = nullptr;
+  double* posx_ptr = nullptr;
+  double* posy_ptr = nullptr;
+  MPI_Win win;
+};
+
+#endif /* end of include guard: PEAK_CACHE_H_W5HN0JQE */
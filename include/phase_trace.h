@@ -0,0 +1,56 @@
+#ifndef PHASE_TRACE_H_R2VD8MXK
+#define PHASE_TRACE_H_R2VD8MXK
+#include <mpi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * a single timed phase of a chunk, relative to the origin of the trace
+ */
+struct trace_event {
+  char const* name = nullptr;
+  uint64_t chunk = 0;
+  int64_t begin_ns = 0;
+  int64_t end_ns = 0;
+  uint32_t thread = 0;
+};
+
+/**
+ * records the begin and end of each phase of each chunk into a preallocated buffer
+ *
+ * a default constructed trace is disabled and record() does nothing.  record() may be called from the
+ * pipeline thread; events past the capacity are counted and dropped rather than allocating.
+ * The trace is written as Chrome trace-event JSON with one process per rank and one thread per
+ * pipeline thread.
+ */
+class phase_trace {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  phase_trace() = default;
+  phase_trace(phase_trace const&) = delete;
+  phase_trace& operator=(phase_trace const&) = delete;
+
+  /** enables the trace with room for capacity events; collective over comm to align the origins */
+  void start(size_t capacity, MPI_Comm comm);
+  bool enabled() const { return !events.empty(); }
+
+  /** records a phase that began at begin and ends now; name must outlive the trace */
+  void record(char const* name, uint64_t chunk, clock::time_point begin, uint32_t thread = 0);
+
+  size_t dropped() const;
+
+  /** gathers the events of every rank of comm and writes them to path from rank 0; collective */
+  void dump(std::string const& path, MPI_Comm comm) const;
+
+ private:
+  std::vector<trace_event> events;
+  std::atomic<size_t> next{0};
+  clock::time_point origin;
+};
+
+#endif /* end of include guard: PHASE_TRACE_H_R2VD8MXK */
@@ -0,0 +1,68 @@
+#ifndef RAW_FRAME_READER_H_Z8LD5WQP
+#define RAW_FRAME_READER_H_Z8LD5WQP
+#include <hdf5.h>
+#include <libpressio_ext/cpp/data.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hdf5_helpers.h"
+
+/**
+ * reads frames of a contiguous dataset directly from the file, bypassing HDF5
+ *
+ * pread reads into the caller's buffer; direct uses O_DIRECT through an aligned bounce buffer so the
+ * frames do not pass through the page cache; mmap maps the dataset read-only once and hands out
+ * non-owning views of the mapping.
+ */
+class raw_frame_reader {
+ public:
+  enum class mode { pread, direct, mmap };
+
+  /** \throws std::runtime_error for an unknown mode */
+  static mode parse_mode(std::string const& name);
+  static const char* mode_name(mode how);
+
+  /**
+   * \returns a reader for the dataset, or nullptr if it is not stored contiguously in path as native
+   * floats, in which case the caller should use the HDF5 path
+   */
+  static std::unique_ptr<raw_frame_reader> open(std::string const& path, h5dset const& dset, mode how);
+
+  ~raw_frame_reader();
+  raw_frame_reader(raw_frame_reader const&) = delete;
+  raw_frame_reader& operator=(raw_frame_reader const&) = delete;
+
+  /**
+   * reads frames [first, first+count) into data, which must have the dimensions of count frames
+   *
+   * in mmap mode data is replaced by a non-owning read-only view of the mapping
+   */
+  void read(hsize_t first, size_t count, pressio_data& data);
+
+ private:
+  raw_frame_reader() = default;
+  void read_bytes(void* buffer, off_t offset, size_t bytes);
+
+  mode how = mode::pread;
+  int fd = -1;
+  off_t data_offset = 0;
+  size_t frame_bytes = 0;
+  size_t frames = 0;
+  pressio_dtype dtype = pressio_float_dtype;
+  std::vector<size_t> frame_dims;
+
+  // mmap mode
+  void* map = nullptr;
+  size_t map_bytes = 0;
+  size_t map_skew = 0;
+
+  // direct mode
+  void* bounce = nullptr;
+  size_t bounce_bytes = 0;
+};
+
+#endif /* end of include guard: RAW_FRAME_READER_H_Z8LD5WQP */
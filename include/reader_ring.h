@@ -0,0 +1,98 @@
+#ifndef READER_RING_H_C4VN8XRE
+#define READER_RING_H_C4VN8XRE
+#include <mpi.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "work_schedule.h"
+
+/**
+ * a chunk of events staged in the ring: nPeaks, the padded peakXPosRaw/peakYPosRaw rows and the frames
+ */
+struct ring_slot {
+  size_t id = 0;
+  size_t work_items = 0;
+  int64_t* npeaks = nullptr;
+  double* posx = nullptr;
+  double* posy = nullptr;
+  float* frames = nullptr;
+};
+
+/**
+ * hands chunks read by dedicated reader ranks to the worker ranks of a node through an MPI shared-memory
+ * window
+ *
+ * each worker owns a ring of slots.  The worker requests the ranges its schedule assigns it in order,
+ * a reader fills the slots and marks them ready, and the worker uses the slot in place and releases it once
+ * the chunk is written.  Slot states are handed over with lock-free atomics, so neither side makes MPI calls
+ * after construction.  Construction and destruction are collective over node_comm, whose first workers
+ * ranks are the workers and whose remaining ranks are the readers.
+ */
+class reader_ring {
+ public:
+  struct shape {
+    uint64_t slots = 0;
+    uint64_t chunk_size = 0;
+    uint64_t max_peaks = 0;
+    uint64_t frame_elements = 0;
+  };
+
+  /**
+   * the shape of rank 0 of node_comm is used by every rank; if its slots is 0, nothing is shared and
+   * enabled() is false
+   */
+  reader_ring(shape const& requested, size_t workers, MPI_Comm node_comm);
+  ~reader_ring();
+  reader_ring(reader_ring const&) = delete;
+  reader_ring& operator=(reader_ring const&) = delete;
+
+  bool enabled() const { return ring.slots != 0; }
+  size_t num_readers() const { return readers; }
+  size_t size_in_bytes() const { return bytes; }
+
+  // worker side
+
+  /** \returns false if the next slot still holds a chunk that has not been released */
+  bool request(work_range const& range);
+  /** waits until the oldest requested chunk has been read */
+  ring_slot acquire();
+  /** returns the oldest acquired slot to the reader */
+  void release();
+  /** tells the reader no more chunks will be requested */
+  void finish();
+  /** seconds spent in acquire() waiting on the reader */
+  double wait_seconds() const { return waited; }
+
+  // reader side
+
+  /** reads the chunks requested by the workers assigned to this reader until all of them finish */
+  void serve(std::function<void(ring_slot&)> const& read);
+
+ private:
+  enum state : uint32_t { slot_free, slot_requested, slot_ready };
+  struct slot_header {
+    std::atomic<uint32_t> state;
+    uint64_t id;
+    uint64_t work_items;
+  };
+  static_assert(std::atomic<uint32_t>::is_always_lock_free, "slot states must be lock-free to be shared");
+
+  slot_header& header(size_t worker, size_t slot) const;
+  std::atomic<uint32_t>& finished(size_t worker) const;
+  ring_slot view(size_t worker, size_t slot) const;
+
+  shape ring;
+  size_t workers = 0, readers = 0, rank = 0;
+  size_t slot_bytes = 0, bytes = 0;
+  size_t npeaks_offset = 0, posx_offset = 0, posy_offset = 0, frames_offset = 0;
+  char* base = nullptr;
+  char* payload = nullptr;
+  size_t requested_count = 0, acquired_count = 0, released_count = 0;
+  double waited = 0;
+  MPI_Win win = MPI_WIN_NULL;
+};
+
+#endif /* end of include guard: READER_RING_H_C4VN8XRE */
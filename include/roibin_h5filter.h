@@ -0,0 +1,58 @@
+#ifndef ROIBIN_H5FILTER_H_K5XH2NWD
+#define ROIBIN_H5FILTER_H_K5XH2NWD
+#include <hdf5.h>
+#include <libpressio_ext/cpp/data.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * HDF5 filter id of the roibin filter; within 32768-65535, which HDF5 leaves for filters that are not
+ * registered with The HDF Group (256-511 is for testing)
+ */
+constexpr H5Z_filter_t roibin_h5filter_id = 47016;
+
+/**
+ * layout of the header that starts every chunk written with the roibin filter
+ *
+ * the header is followed by the {3, centers} uint64 roibin:centers of the chunk and stream_length bytes
+ * of compressed data.  The compressor configuration is the same for every chunk, so it is stored once in
+ * the cd_values of the filter (see roibin_h5filter_cd_values); with the centers in every chunk a reader
+ * can decompress any chunk on its own.
+ */
+struct roibin_chunk_header {
+  char magic[8] = {'R', 'O', 'I', 'B', 'I', 'N', 'H', '5'};
+  uint32_t version = 2;
+  uint32_t dtype = 0;
+  uint64_t centers = 0;
+  uint64_t dims[3] = {0, 0, 0};
+  uint64_t stream_length = 0;
+};
+
+/**
+ * \returns the cd_values for H5Pset_filter that carry the json configuration of the compressor: its length
+ * in bytes followed by the bytes packed four to a value
+ */
+std::vector<unsigned int> roibin_h5filter_cd_values(std::string const& config);
+
+/**
+ * \returns a chunk for H5Dwrite_chunk holding the compressed stream of a single event
+ * \param centers the {3, n} roibin:centers of the event
+ * \param dims the dimensions of the uncompressed event in libpressio order
+ * \param dtype the type of the uncompressed event
+ * \param stream the compressed stream
+ */
+pressio_data roibin_h5filter_encode(std::vector<uint64_t> const& centers, std::vector<size_t> const& dims,
+                                    pressio_dtype dtype, pressio_data const& stream);
+
+/**
+ * the filter class; chunks are written already compressed with H5Dwrite_chunk, so the encoder only exists
+ * to let HDF5 create datasets with the filter and rejects every chunk passed through it
+ */
+extern const H5Z_class2_t roibin_h5filter_class[1];
+
+/** registers the filter with the HDF5 library of this process */
+void roibin_h5filter_register();
+
+#endif /* end of include guard: ROIBIN_H5FILTER_H_K5XH2NWD */
@@ -0,0 +1,67 @@
+#ifndef ROIBIN_TEST_H_Q7ZB3WLC
+#define ROIBIN_TEST_H_Q7ZB3WLC
+#include <libpressio_ext/cpp/data.h>
+#include <libpressio_ext/cpp/options.h>
+
+#include <cstdint>
+#include <future>
+#include <vector>
+
+/**
+ * consecutive events of a chunk compressed on their own by one compression thread
+ */
+struct chunk_part {
+  // relative to the first event of the chunk
+  size_t first = 0;
+  size_t events = 0;
+  // the chunk's centers of these events, numbered from the first event of the part
+  std::vector<uint64_t> centers;
+  pressio_data compressed;
+};
+
+/**
+ * the buffers and results for a single chunk of events owned by one rank
+ *
+ * chunks are recycled between iterations of the event loop, so the buffers
+ * keep their allocations across reads
+ */
+struct work_chunk {
+  size_t id = 0;
+  size_t read_work_items = 0;
+
+  pressio_data peaks_data;
+  // if set, posx_data/posy_data hold only the first nPeaks columns of each event packed back to back
+  bool sparse_peaks = false;
+  pressio_data posx_data;
+  pressio_data posy_data;
+  pressio_data data_data;
+  pressio_data centers;
+  pressio_data data_comp;
+  pressio_data data_output;
+  // with compression threads or a filtered file, the compressed streams of the parts of the chunk take the
+  // place of data_comp
+  std::vector<chunk_part> parts;
+
+  // buffers acquired from the buffer_pool for this chunk, released once the chunk is written
+  std::vector<void*> pooled;
+  void* pooled_comp = nullptr;
+
+  pressio_options metrics_results;
+  uint64_t compress_time_ms = 0;
+  uint64_t decompress_time_ms = 0;
+
+  // ready once compression (and decompression if requested) finishes
+  std::future<void> compressed;
+};
+
+/**
+ * a compressed chunk kept in memory for the repeated decompression benchmark
+ */
+struct kept_chunk {
+  pressio_data compressed;
+  pressio_data centers;
+  std::vector<size_t> dims;
+  pressio_dtype dtype = pressio_float_dtype;
+};
+
+#endif /* end of include guard: ROIBIN_TEST_H_Q7ZB3WLC */
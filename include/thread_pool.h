@@ -0,0 +1,77 @@
+#ifndef THREAD_POOL_H_4TQXK2PA
+#define THREAD_POOL_H_4TQXK2PA
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * a fixed size pool of threads that executes tasks in submission order
+ *
+ * with a single thread, tasks are executed serially in the order submitted.
+ * exceptions thrown by a task are re-thrown from the corresponding future.
+ * tasks MUST NOT make MPI calls; MPI is only initialized with MPI_THREAD_FUNNELED
+ */
+class thread_pool {
+ public:
+  explicit thread_pool(size_t nthreads) {
+    workers.reserve(nthreads);
+    for (size_t i = 0; i < nthreads; ++i) {
+      workers.emplace_back([this] { run(); });
+    }
+  }
+  ~thread_pool() {
+    {
+      std::lock_guard lock(mtx);
+      stopping = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator=(thread_pool const&) = delete;
+
+  size_t size() const { return workers.size(); }
+
+  template <class F>
+  std::future<std::invoke_result_t<F>> submit(F&& func) {
+    using result_t = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(func));
+    auto result = task->get_future();
+    {
+      std::lock_guard lock(mtx);
+      tasks.emplace_back([task] { (*task)(); });
+    }
+    cv.notify_one();
+    return result;
+  }
+
+ private:
+  void run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(mtx);
+        cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::thread> workers;
+  bool stopping = false;
+};
+
+#endif /* end of include guard: THREAD_POOL_H_4TQXK2PA */
@@ -0,0 +1,156 @@
+#ifndef WORK_SCHEDULE_H_R2MXC8VD
+#define WORK_SCHEDULE_H_R2MXC8VD
+#include <mpi.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * a contiguous range of events assigned to a rank
+ */
+struct work_range {
+  size_t id = 0;
+  size_t work_items = 0;
+};
+
+/**
+ * decides which events each rank processes next
+ */
+class work_schedule {
+ public:
+  virtual ~work_schedule() = default;
+  /**
+   * \param[out] range the next range of events for this rank; it may be empty for lockstep schedules
+   * \returns false once this rank has no further work
+   */
+  virtual bool next(work_range& range) = 0;
+  /**
+   * \returns true if every rank calls next() the same number of times so collective I/O and
+   * per-chunk collectives are permitted
+   */
+  virtual bool lockstep() const = 0;
+};
+
+/**
+ * the original static assignment: at step i, rank r processes events [i + r*chunk_size, +chunk_size)
+ */
+class static_schedule : public work_schedule {
+ public:
+  static_schedule(size_t num_events, size_t chunk_size, MPI_Comm comm);
+  bool next(work_range& range) override;
+  bool lockstep() const override { return true; }
+
+ private:
+  size_t num_events, chunk_size, step_size, rank_offset, i = 0;
+};
+
+/**
+ * ranks pull the next chunk_size events from a shared counter hosted on rank 0 of comm using
+ * MPI_Fetch_and_op as soon as they finish their previous chunk
+ *
+ * construction and destruction are collective over comm
+ */
+class dynamic_schedule : public work_schedule {
+ public:
+  dynamic_schedule(size_t num_events, size_t chunk_size, MPI_Comm comm);
+  ~dynamic_schedule() override;
+  dynamic_schedule(dynamic_schedule const&) = delete;
+  dynamic_schedule& operator=(dynamic_schedule const&) = delete;
+  bool next(work_range& range) override;
+  bool lockstep() const override { return false; }
+
+ protected:
+  /** claims the next count events from the shared counter */
+  bool claim(size_t count, work_range& range);
+
+ private:
+  size_t num_events, chunk_size;
+  uint64_t* counter = nullptr;
+  MPI_Win win;
+};
+
+/**
+ * a dynamic_schedule where each rank sizes the ranges it claims from the throughput of its previous ones
+ *
+ * a rank starts with min_chunk events and doubles its chunk size while the measured throughput improves,
+ * reverses direction once it drops by more than tolerance, and holds the size otherwise.  Sizes are
+ * multiples of min_chunk no larger than max_chunk, the capacity of the chunk buffers.  Ranges are still
+ * claimed from one shared counter, so every event is processed exactly once.
+ */
+class adaptive_schedule : public dynamic_schedule {
+ public:
+  adaptive_schedule(size_t num_events, size_t min_chunk, size_t max_chunk, MPI_Comm comm, double tolerance = 0.05);
+  bool next(work_range& range) override;
+
+  /**
+   * records that the range starting at event id finished, bytes bytes of input after the previous one,
+   * and picks the size of the ranges claimed from now on
+   */
+  void observe(size_t id, size_t bytes);
+  size_t chunk_size() const { return current; }
+
+  struct change {
+    size_t event;
+    size_t chunk_size;
+    double rate_GBps;
+  };
+  /** every chunk size chosen by this rank with the event at which it was chosen, starting with min_chunk */
+  std::vector<change> const& changes() const { return history; }
+
+ private:
+  size_t min_chunk, max_chunk, current;
+  double tolerance;
+  int direction = 1;
+  double previous_rate = 0;
+  std::chrono::steady_clock::time_point last;
+  bool started = false;
+  std::vector<change> history;
+};
+
+/**
+ * predicted cost of compressing an event: a fixed cost per frame plus a cost per peak ROI
+ */
+struct cost_model {
+  double frame_cost = 1.0;
+  double peak_cost = 0.005;
+  double operator()(int64_t npeaks) const { return frame_cost + peak_cost * static_cast<double>(npeaks); }
+};
+
+/**
+ * splits events into parts contiguous ranges with approximately equal predicted cost
+ *
+ * boundaries are rounded to multiples of alignment, such as the events per HDF5 chunk, so that no
+ * chunk is split between parts
+ *
+ * \returns parts+1 boundaries; part p owns events [boundaries[p], boundaries[p+1])
+ */
+std::vector<size_t> partition_by_cost(std::vector<int64_t> const& npeaks, cost_model const& model,
+                                      size_t parts, size_t alignment = 1);
+
+/**
+ * each rank owns a contiguous range of events chosen by partition_by_cost over the nPeaks of every
+ * event and walks it in chunks of chunk_size
+ *
+ * ranks with fewer chunks are padded with empty ranges so that every rank calls next() the same
+ * number of times and collective I/O can still be used.  Construction is collective over comm.
+ */
+class weighted_schedule : public work_schedule {
+ public:
+  weighted_schedule(std::vector<int64_t> const& npeaks, cost_model const& model, size_t chunk_size,
+                    MPI_Comm comm, size_t alignment = 1);
+  bool next(work_range& range) override;
+  bool lockstep() const override { return true; }
+
+  /** \returns the cost predicted by the model for the range owned by this rank */
+  double predicted_cost() const { return cost; }
+  size_t begin() const { return first; }
+  size_t end() const { return last; }
+
+ private:
+  size_t first, last, chunk_size, i, steps, step = 0;
+  double cost = 0;
+};
+
+#endif /* end of include guard: WORK_SCHEDULE_H_R2MXC8VD */
@@ -0,0 +1,92 @@
+#ifndef WRITE_AGGREGATOR_H_P2HX7KTD
+#define WRITE_AGGREGATOR_H_P2HX7KTD
+#include <libpressio_ext/cpp/data.h>
+#include <mpi.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "hdf5_helpers.h"
+
+/**
+ * counters for the writes made by the aggregators
+ */
+struct write_aggregator_stats {
+  size_t writes = 0;
+  size_t bytes_written = 0;
+  double write_seconds = 0;
+};
+
+/**
+ * funnels the decompressed frames of every rank through a few aggregator ranks that write them
+ *
+ * each aggregator owns an equal contiguous range of the events of the dataset.  Ranks send the parts of
+ * their chunks to the owning aggregators with non-blocking MPI, and aggregators stage what they receive and
+ * write each run of contiguous events with one independent H5Dwrite once the staged bytes exceed
+ * buffer_bytes.  Aggregators only receive when progress() or finish() is called, so ranks that also compress
+ * should call progress() after every chunk.
+ *
+ * construction and finish() are collective over comm
+ */
+class write_aggregator {
+ public:
+  write_aggregator(h5dset const& dset, bool aggregator, size_t buffer_bytes, buffer_pool& pool, MPI_Comm comm);
+  ~write_aggregator();
+  write_aggregator(write_aggregator const&) = delete;
+  write_aggregator& operator=(write_aggregator const&) = delete;
+
+  size_t num_aggregators() const { return aggregators.size(); }
+  bool is_aggregator() const { return aggregator_index < aggregators.size(); }
+  write_aggregator_stats stats() const { return counters; }
+
+  /**
+   * sends events [first_event, first_event+events) of frames to their aggregators without waiting
+   *
+   * frames is kept until the sends complete; pooled, if set, is then released to the pool
+   */
+  void send(size_t first_event, size_t events, pressio_data&& frames, void const* pooled);
+  /** completes finished sends and receives and writes whatever has arrived */
+  void progress();
+  /** waits for every rank's frames to be sent and written */
+  void finish();
+
+ private:
+  struct pending_send {
+    std::vector<MPI_Request> requests;
+    // (first_event, events) of each part
+    std::vector<uint64_t> headers;
+    pressio_data frames;
+    void const* pooled;
+  };
+
+  bool receive(bool wait);
+  void write_staged();
+
+  h5dset const* dset;
+  h5transfer output;
+  std::vector<hsize_t> frame_dims;
+  size_t frame_bytes = 0;
+  size_t num_events = 0;
+  size_t buffer_bytes = 0;
+  buffer_pool* pool;
+  MPI_Comm comm;
+  MPI_Datatype frame_type;
+
+  std::vector<int> aggregators;
+  size_t aggregator_index = 0;
+  std::list<pending_send> sends;
+  std::vector<uint64_t> done_header;
+
+  // aggregator side: received frames keyed by their first event
+  std::map<size_t, std::vector<char>> staged;
+  size_t staged_bytes = 0;
+  int senders_done = 0;
+  std::vector<char> merged;
+  write_aggregator_stats counters;
+};
+
+#endif /* end of include guard: WRITE_AGGREGATOR_H_P2HX7KTD */
@@ -0,0 +1,142 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "centers_builder.h"
+#include "roibin_test_version.h"
+
+const std::string usage = R"(bench_centers
+microbenchmark for building roibin:centers from peak tables
+
+-e <events> events per chunk (default: 64)
+-p <peaks> mean peaks per event (default: 30)
+-m <max_peaks> maxPeaks columns of the peak tables (default: 2048)
+-i <iterations> number of chunks to build (default: 1000)
+-S peak rows are packed back to back as read with roibin_test -S
+-h print this message
+-v print the version information
+)";
+
+struct cmdline_args {
+  size_t events = 64;
+  double mean_peaks = 30;
+  size_t max_peaks = 2048;
+  size_t iterations = 1000;
+  bool sparse = false;
+};
+
+cmdline_args parse_args(int argc, char* argv[]) {
+  cmdline_args args;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "e:hi:m:p:Sv")) != -1) {
+    switch (opt) {
+      case 'e':
+        args.events = std::stoul(optarg);
+        break;
+      case 'p':
+        args.mean_peaks = std::stod(optarg);
+        break;
+      case 'm':
+        args.max_peaks = std::stoul(optarg);
+        break;
+      case 'i':
+        args.iterations = std::stoul(optarg);
+        break;
+      case 'S':
+        args.sparse = true;
+        break;
+      case 'h':
+        std::cout << usage << std::endl;
+        exit(0);
+        break;
+      case 'v':
+        std::cout << ROIBIN_TEST_VERSION << std::endl;
+        exit(0);
+        break;
+    }
+  }
+  return args;
+}
+
+// the centers construction roibin_test used before centers_builder, for comparison
+void build_reference(int64_t const* npeaks_ptr, size_t read_work_items, double const* posx_ptr,
+                     double const* posy_ptr, size_t max_peaks, pressio_data& centers) {
+  size_t peaks_in_work = 0;
+  std::vector<size_t> peaks_to_events, to_start_of_event;
+  peaks_to_events.reserve(max_peaks * read_work_items);
+  to_start_of_event.reserve(read_work_items * read_work_items);
+  for (size_t k = 0; k < read_work_items; ++k) {
+    peaks_in_work += npeaks_ptr[k];
+    for (int64_t j = 0; j < npeaks_ptr[k]; ++j) {
+      peaks_to_events.push_back(k);
+      to_start_of_event.push_back(j);
+    }
+  }
+  centers = pressio_data::owning(pressio_uint64_dtype, {3, peaks_in_work});
+  auto centers_ptr = static_cast<uint64_t*>(centers.data());
+  for (size_t k = 0; k < peaks_in_work; ++k) {
+    centers_ptr[k * 3] = static_cast<size_t>(posx_ptr[peaks_to_events[k] * max_peaks + to_start_of_event[k]]);
+    centers_ptr[k * 3 + 1] = static_cast<size_t>(posy_ptr[peaks_to_events[k] * max_peaks + to_start_of_event[k]]);
+    centers_ptr[k * 3 + 2] = peaks_to_events[k];
+  }
+}
+
+int main(int argc, char* argv[]) {
+  auto args = parse_args(argc, argv);
+  size_t const frame_x = 1552, frame_y = 1480;
+
+  std::mt19937_64 gen(0);
+  std::poisson_distribution<int64_t> peaks_dist(args.mean_peaks);
+  std::uniform_real_distribution<double> x_dist(0, frame_x), y_dist(0, frame_y);
+
+  std::vector<int64_t> npeaks(args.events);
+  std::vector<double> posx(args.events * args.max_peaks, 0), posy(args.events * args.max_peaks, 0);
+  size_t total_peaks = 0;
+  for (size_t k = 0; k < args.events; ++k) {
+    npeaks[k] = std::min<int64_t>(peaks_dist(gen), args.max_peaks);
+    for (int64_t j = 0; j < npeaks[k]; ++j) {
+      posx[k * args.max_peaks + j] = x_dist(gen);
+      posy[k * args.max_peaks + j] = y_dist(gen);
+    }
+    total_peaks += npeaks[k];
+  }
+  std::vector<double> packed_x, packed_y;
+  for (size_t k = 0; k < args.events; ++k) {
+    packed_x.insert(packed_x.end(), posx.begin() + k * args.max_peaks, posx.begin() + k * args.max_peaks + npeaks[k]);
+    packed_y.insert(packed_y.end(), posy.begin() + k * args.max_peaks, posy.begin() + k * args.max_peaks + npeaks[k]);
+  }
+
+  auto centers_per_second = [&](auto&& build) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < args.iterations; ++i) build();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return static_cast<double>(total_peaks * args.iterations) / elapsed.count();
+  };
+
+  pressio_data reference_centers;
+  double reference_rate = centers_per_second([&] {
+    build_reference(npeaks.data(), args.events, posx.data(), posy.data(), args.max_peaks, reference_centers);
+  });
+
+  centers_builder builder({frame_x, frame_y});
+  pressio_data centers;
+  double builder_rate = centers_per_second([&] {
+    if (args.sparse) {
+      builder.build(npeaks.data(), args.events, packed_x.data(), packed_y.data(), 0, centers);
+    } else {
+      builder.build(npeaks.data(), args.events, posx.data(), posy.data(), args.max_peaks, centers);
+    }
+  });
+
+  std::cout << "kernel=" << centers_builder::kernel_name() << std::endl;
+  std::cout << "events=" << args.events << " peaks_per_chunk=" << total_peaks << std::endl;
+  std::cout << "reference_centers_per_second=" << reference_rate << std::endl;
+  std::cout << "builder_centers_per_second=" << builder_rate << std::endl;
+  std::cout << "speedup=" << builder_rate / reference_rate << std::endl;
+}
@@ -0,0 +1,158 @@
+#include <hdf5.h>
+#include <mpi.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cleanup.h"
+#include "hdf5_helpers.h"
+#include "roibin_test_version.h"
+
+const std::string usage = R"(bench_hdf5_io
+microbenchmark for the latency of small hyperslab reads; both methods must first read back the known values
+written to every row
+
+-f <file> scratch hdf5 file to create; with several ranks each rank creates <file>.<rank> (default: bench_hdf5_io.h5)
+-r <rows> rows of the dataset (default: 4096)
+-c <columns> columns of the dataset and doubles per read (default: 2048)
+-i <iterations> number of reads per method (default: 10000)
+-h print this message
+-v print the version information
+)";
+
+struct cmdline_args {
+  std::string filename = "bench_hdf5_io.h5";
+  size_t rows = 4096;
+  size_t columns = 2048;
+  size_t iterations = 10000;
+};
+
+cmdline_args parse_args(int argc, char* argv[]) {
+  cmdline_args args;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "c:f:hi:r:v")) != -1) {
+    switch (opt) {
+      case 'c':
+        args.columns = std::stoul(optarg);
+        break;
+      case 'f':
+        args.filename = optarg;
+        break;
+      case 'i':
+        args.iterations = std::stoul(optarg);
+        break;
+      case 'r':
+        args.rows = std::stoul(optarg);
+        break;
+      case 'h':
+        std::cout << usage << std::endl;
+        exit(0);
+        break;
+      case 'v':
+        std::cout << ROIBIN_TEST_VERSION << std::endl;
+        exit(0);
+        break;
+    }
+  }
+  return args;
+}
+
+// the per-call path read() used before h5transfer, for comparison
+void read_reference(h5dset const& dset, std::vector<hsize_t> const& start, std::vector<hsize_t> const& count,
+                    pressio_data& data) {
+  hid_t file_space = check_hdf5(H5Scopy(dset.space));
+  cleanup cleanup_space([=] { H5Sclose(file_space); });
+  check_hdf5(H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start.data(), /*stride*/ nullptr, count.data(),
+                                 /*block*/ nullptr));
+  hid_t mem_space = check_hdf5(H5Screate_simple(count.size(), count.data(), nullptr));
+  cleanup cleanup_mem_space([=] { H5Sclose(mem_space); });
+  hid_t xfer = check_hdf5(H5Pcreate(H5P_DATASET_XFER));
+  H5Pset_dxpl_mpio(xfer, H5FD_MPIO_INDEPENDENT);
+  cleanup cleanup_xfer([=] { H5Pclose(xfer); });
+  check_hdf5(H5Dread(dset.dset, pressio_to_hdf5_native_type(data.dtype()), mem_space, file_space, xfer,
+                     data.data()));
+}
+
+int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  cleanup cleanup_init([&] { MPI_Finalize(); });
+  auto args = parse_args(argc, argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  // every rank creates, truncates, and unlinks its file, so ranks must not share one
+  if (size > 1) {
+    args.filename += "." + std::to_string(rank);
+  }
+
+  {
+    hid_t fapl = check_hdf5(H5Pcreate(H5P_FILE_ACCESS));
+    cleanup cleanup_fapl([&] { H5Pclose(fapl); });
+    check_hdf5(H5Pset_fapl_mpio(fapl, MPI_COMM_SELF, MPI_INFO_NULL));
+    hid_t file = check_hdf5(H5Fcreate(args.filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl));
+    cleanup cleanup_file([&] { H5Fclose(file); unlink(args.filename.c_str()); });
+
+    std::vector<hsize_t> dims{args.rows, args.columns};
+    hid_t space = check_hdf5(H5Screate_simple(dims.size(), dims.data(), nullptr));
+    cleanup cleanup_space([&] { H5Sclose(space); });
+    hid_t dset_id = check_hdf5(
+        H5Dcreate(file, "data", H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+    cleanup cleanup_dset_id([&] { H5Dclose(dset_id); });
+    // element (r, c) holds r * columns + c so that a read of the wrong row or columns is detected
+    {
+      std::vector<double> values(args.rows * args.columns);
+      for (size_t i = 0; i < values.size(); ++i) values[i] = static_cast<double>(i);
+      check_hdf5(H5Dwrite(dset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()));
+    }
+    auto dset = open_dset(file, "data");
+
+    std::vector<double> row(args.columns);
+    auto data = pressio_data::nonowning(pressio_double_dtype, row.data(), {args.columns, 1});
+    std::vector<hsize_t> count{1, args.columns};
+    h5transfer transfer(dset, H5FD_MPIO_INDEPENDENT);
+
+    // both methods must read the values written above before they are timed
+    auto check_rows = [&](const char* method, auto&& read_row) {
+      for (size_t r = 0; r < args.rows; ++r) {
+        std::fill(row.begin(), row.end(), -1.0);
+        read_row(std::vector<hsize_t>{r, 0});
+        for (size_t c = 0; c < args.columns; ++c) {
+          if (row[c] != static_cast<double>(r * args.columns + c)) {
+            std::cerr << method << " read " << row[c] << " at row " << r << " column " << c << std::endl;
+            return false;
+          }
+        }
+      }
+      return true;
+    };
+    auto reference_read = [&](std::vector<hsize_t> const& start) { read_reference(dset, start, count, data); };
+    auto transfer_read = [&](std::vector<hsize_t> const& start) { transfer.read(start, count, data, 1); };
+    if (!check_rows("reference", reference_read) || !check_rows("transfer", transfer_read)) {
+      return 1;
+    }
+
+    // cycle over the rows so every read is a different hyperslab
+    auto time_reads = [&](auto&& read_row) {
+      auto begin = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < args.iterations; ++i) {
+        read_row(std::vector<hsize_t>{i % args.rows, 0});
+      }
+      auto end = std::chrono::steady_clock::now();
+      return std::chrono::duration<double, std::micro>(end - begin).count() / args.iterations;
+    };
+
+    double const reference_us = time_reads(reference_read);
+    double const transfer_us = time_reads(transfer_read);
+
+    std::cout << "bytes_per_read=" << args.columns * sizeof(double) << std::endl;
+    std::cout << "reference_read_us=" << reference_us << std::endl;
+    std::cout << "transfer_read_us=" << transfer_us << std::endl;
+    std::cout << "speedup=" << reference_us / transfer_us << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+#include "buffer_pool.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <numeric>
+
+namespace {
+constexpr size_t alignment = 64;
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+// a free buffer is only handed out for requests at least 1/max_oversize of its size, so a small request
+// does not pin a large buffer that a later large request then has to allocate again
+constexpr size_t max_oversize = 2;
+
+size_t round_up(size_t bytes, size_t multiple) { return (bytes + multiple - 1) / multiple * multiple; }
+}  // namespace
+
+buffer_pool::buffer_pool(bool huge_pages) : huge_pages(huge_pages) {}
+
+buffer_pool::~buffer_pool() {
+  for (auto const& [bytes, ptr] : free_buffers) {
+    deallocate(ptr, bytes);
+  }
+  for (auto const& [ptr, bytes] : in_use) {
+    deallocate(const_cast<void*>(ptr), bytes);
+  }
+}
+
+pressio_data buffer_pool::acquire(pressio_dtype dtype, std::vector<size_t> const& dims) {
+  size_t const requested =
+      pressio_dtype_size(dtype) * std::accumulate(dims.begin(), dims.end(), size_t{1}, std::multiplies<>{});
+  size_t const bytes = round_up(std::max<size_t>(requested, 1), huge_pages ? huge_page_size : alignment);
+
+  std::lock_guard lock(mtx);
+  void* ptr;
+  auto it = free_buffers.lower_bound(bytes);
+  if (it != free_buffers.end() && it->first <= max_oversize * bytes) {
+    ptr = it->second;
+    in_use.emplace(ptr, it->first);
+    free_buffers.erase(it);
+    counters.bytes_reused += requested;
+    ++counters.reuses;
+  } else {
+    ptr = allocate(bytes);
+    in_use.emplace(ptr, bytes);
+    counters.bytes_allocated += requested;
+    ++counters.allocations;
+  }
+  return pressio_data::nonowning(dtype, ptr, dims);
+}
+
+void buffer_pool::release(void const* ptr) {
+  std::lock_guard lock(mtx);
+  auto it = in_use.find(ptr);
+  if (it == in_use.end()) return;
+  free_buffers.emplace(it->second, const_cast<void*>(it->first));
+  in_use.erase(it);
+}
+
+bool buffer_pool::owns(void const* ptr) const {
+  std::lock_guard lock(mtx);
+  return in_use.count(ptr) != 0;
+}
+
+buffer_pool_stats buffer_pool::stats() const {
+  std::lock_guard lock(mtx);
+  return counters;
+}
+
+void* buffer_pool::allocate(size_t bytes) {
+  if (huge_pages) {
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) throw std::bad_alloc();
+    // transparent huge pages are best effort; the buffer is still usable if this fails
+    (void)madvise(ptr, bytes, MADV_HUGEPAGE);
+    return ptr;
+  }
+  void* ptr = std::aligned_alloc(alignment, bytes);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void buffer_pool::deallocate(void* ptr, size_t bytes) {
+  if (huge_pages) {
+    munmap(ptr, bytes);
+  } else {
+    std::free(ptr);
+  }
+}
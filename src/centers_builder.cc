@@ -0,0 +1,174 @@
+#include "centers_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// marks a NaN coordinate in the converted output
+constexpr uint64_t nan_marker = std::numeric_limits<uint64_t>::max();
+
+/**
+ * truncates in[i] to an integer clamped to [0, limit] for i in [0, n)
+ * \returns the number of non-NaN values that were clamped
+ */
+using convert_fn = size_t (*)(double const* in, size_t n, uint64_t limit, uint64_t* out);
+
+size_t convert_scalar(double const* in, size_t n, uint64_t limit, uint64_t* out) {
+  size_t clamped = 0;
+  double const upper = static_cast<double>(limit);
+  for (size_t i = 0; i < n; ++i) {
+    double const v = in[i];
+    if (std::isnan(v)) {
+      out[i] = nan_marker;
+    } else if (v < 0) {
+      out[i] = 0;
+      ++clamped;
+    } else if (v >= upper + 1) {
+      out[i] = limit;
+      ++clamped;
+    } else {
+      out[i] = static_cast<uint64_t>(v);
+    }
+  }
+  return clamped;
+}
+
+#if defined(__x86_64__)
+// the tails are handled with masked loads and stores so the kernels never fall back to SSE code
+// with dirty upper registers, which costs more than the conversion itself for short rows
+
+__attribute__((target("avx2"))) size_t convert_avx2(double const* in, size_t n, uint64_t limit,
+                                                     uint64_t* out) {
+  // frame extents are far below 2^52, so adding 2^52 to a floored non-negative value leaves the
+  // integer in the low mantissa bits
+  __m256d const magic = _mm256_set1_pd(4503599627370496.0);
+  __m256d const zero = _mm256_setzero_pd();
+  __m256d const upper = _mm256_set1_pd(static_cast<double>(limit));
+  __m256d const upper_exclusive = _mm256_set1_pd(static_cast<double>(limit) + 1);
+  __m256i const nan_bits = _mm256_set1_epi64x(-1);
+  __m256i const lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+  size_t clamped = 0;
+  for (size_t i = 0; i < n; i += 4) {
+    __m256i const mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<int64_t>(n - i)), lanes);
+    __m256d v = _mm256_maskload_pd(in + i, mask);
+    __m256d is_nan = _mm256_cmp_pd(v, v, _CMP_UNORD_Q);
+    __m256d out_of_frame =
+        _mm256_or_pd(_mm256_cmp_pd(v, zero, _CMP_LT_OQ), _mm256_cmp_pd(v, upper_exclusive, _CMP_GE_OQ));
+    clamped += __builtin_popcount(_mm256_movemask_pd(_mm256_and_pd(out_of_frame, _mm256_castsi256_pd(mask))));
+    v = _mm256_min_pd(_mm256_max_pd(_mm256_floor_pd(v), zero), upper);
+    __m256i bits = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(v, magic)), _mm256_castpd_si256(magic));
+    bits = _mm256_blendv_epi8(bits, nan_bits, _mm256_castpd_si256(is_nan));
+    _mm256_maskstore_epi64(reinterpret_cast<long long*>(out + i), mask, bits);
+  }
+  return clamped;
+}
+
+__attribute__((target("avx512f,avx512dq"))) size_t convert_avx512(double const* in, size_t n,
+                                                                   uint64_t limit, uint64_t* out) {
+  __m512d const zero = _mm512_setzero_pd();
+  __m512d const upper = _mm512_set1_pd(static_cast<double>(limit));
+  __m512d const upper_exclusive = _mm512_set1_pd(static_cast<double>(limit) + 1);
+  __m512i const nan_bits = _mm512_set1_epi64(-1);
+  size_t clamped = 0;
+  for (size_t i = 0; i < n; i += 8) {
+    __mmask8 const mask = (n - i >= 8) ? 0xff : static_cast<__mmask8>((1u << (n - i)) - 1);
+    __m512d v = _mm512_maskz_loadu_pd(mask, in + i);
+    __mmask8 is_nan = _mm512_cmp_pd_mask(v, v, _CMP_UNORD_Q);
+    __mmask8 below = _mm512_cmp_pd_mask(v, zero, _CMP_LT_OQ);
+    __mmask8 above = _mm512_cmp_pd_mask(v, upper_exclusive, _CMP_GE_OQ);
+    clamped += __builtin_popcount((below | above) & mask);
+    v = _mm512_mask_mov_pd(_mm512_mask_mov_pd(v, below, zero), above, upper);
+    __m512i bits = _mm512_mask_mov_epi64(_mm512_cvttpd_epu64(v), is_nan, nan_bits);
+    _mm512_mask_storeu_epi64(out + i, mask, bits);
+  }
+  return clamped;
+}
+#endif
+
+struct kernel {
+  convert_fn fn;
+  const char* name;
+};
+
+kernel select_kernel() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+    return {convert_avx512, "avx512"};
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return {convert_avx2, "avx2"};
+  }
+#endif
+  return {convert_scalar, "scalar"};
+}
+
+kernel const& active_kernel() {
+  static const kernel k = select_kernel();
+  return k;
+}
+}  // namespace
+
+centers_builder::centers_builder(std::array<size_t, 2> frame_dims)
+    : limits{frame_dims[0] ? frame_dims[0] - 1 : 0, frame_dims[1] ? frame_dims[1] - 1 : 0} {}
+
+const char* centers_builder::kernel_name() { return active_kernel().name; }
+
+centers_stats centers_builder::build(int64_t const* npeaks, size_t events, double const* posx,
+                                     double const* posy, size_t row_stride, pressio_data& centers) {
+  centers_stats stats;
+  for (size_t k = 0; k < events; ++k) {
+    stats.peaks += std::max<int64_t>(npeaks[k], 0);
+  }
+  size_t const needed_bytes = 3 * stats.peaks * sizeof(uint64_t);
+  if (centers.dtype() != pressio_uint64_dtype || centers.capacity_in_bytes() < needed_bytes) {
+    centers = pressio_data::owning(pressio_uint64_dtype, {3, stats.peaks});
+  }
+  centers.set_dimensions({3, stats.peaks});
+
+  // convert every coordinate of the chunk into packed scratch buffers; packed rows are converted in a
+  // single pass, padded rows one event at a time
+  auto const convert = active_kernel().fn;
+  if (x_scratch.size() < stats.peaks) {
+    x_scratch.resize(stats.peaks);
+    y_scratch.resize(stats.peaks);
+  }
+  if (row_stride == 0) {
+    stats.clamped += convert(posx, stats.peaks, limits[0], x_scratch.data());
+    stats.clamped += convert(posy, stats.peaks, limits[1], y_scratch.data());
+  } else {
+    size_t packed = 0;
+    for (size_t k = 0; k < events; ++k) {
+      size_t const n = std::max<int64_t>(npeaks[k], 0);
+      stats.clamped += convert(posx + k * row_stride, n, limits[0], x_scratch.data() + packed);
+      stats.clamped += convert(posy + k * row_stride, n, limits[1], y_scratch.data() + packed);
+      packed += n;
+    }
+  }
+
+  auto centers_ptr = static_cast<uint64_t*>(centers.data());
+  size_t out = 0;
+  size_t packed = 0;
+  for (size_t k = 0; k < events; ++k) {
+    size_t const end = packed + std::max<int64_t>(npeaks[k], 0);
+    for (; packed < end; ++packed) {
+      if (x_scratch[packed] == nan_marker || y_scratch[packed] == nan_marker) {
+        ++stats.dropped;
+        continue;
+      }
+      centers_ptr[out * 3] = x_scratch[packed];
+      centers_ptr[out * 3 + 1] = y_scratch[packed];
+      centers_ptr[out * 3 + 2] = k;
+      ++out;
+    }
+  }
+  if (stats.dropped) {
+    centers.set_dimensions({3, out});
+  }
+  return stats;
+}
@@ -0,0 +1,287 @@
+#include "compressed_archive.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+
+#include "cleanup.h"
+#include "hdf5_helpers.h"
+
+namespace {
+constexpr hsize_t index_columns = 5;
+constexpr hsize_t bytes_chunk = 1 << 20;
+constexpr hsize_t index_chunk = 1024;
+constexpr int header_tag = 1101;
+constexpr int entries_tag = 1102;
+constexpr int bytes_tag = 1103;
+constexpr uint64_t done_marker = std::numeric_limits<uint64_t>::max();
+
+hid_t create_extensible(hid_t file, const char* name, hid_t type, int rank, hsize_t const* chunk) {
+  std::array<hsize_t, 2> dims{0, index_columns};
+  std::array<hsize_t, 2> max_dims{H5S_UNLIMITED, index_columns};
+  hid_t space = check_hdf5(H5Screate_simple(rank, dims.data(), max_dims.data()));
+  cleanup cleanup_space([=] { H5Sclose(space); });
+  hid_t dcpl = check_hdf5(H5Pcreate(H5P_DATASET_CREATE));
+  cleanup cleanup_dcpl([=] { H5Pclose(dcpl); });
+  check_hdf5(H5Pset_chunk(dcpl, rank, chunk));
+  return check_hdf5(H5Dcreate(file, name, type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT));
+}
+
+// writes count elements starting at start[0] of a dataset already extended to hold them
+void write_rows(hid_t dset, hid_t type, std::array<hsize_t, 2> const& start, std::array<hsize_t, 2> const& count,
+                void const* buffer, bool collective) {
+  hid_t file_space = check_hdf5(H5Dget_space(dset));
+  cleanup cleanup_file_space([=] { H5Sclose(file_space); });
+  int const rank = H5Sget_simple_extent_ndims(file_space);
+  hsize_t elements = 1;
+  for (int i = 0; i < rank; ++i) elements *= count[i];
+
+  // a dataspace may not be empty, so select nothing from a single element instead
+  hsize_t mem_dims = std::max<hsize_t>(elements, 1);
+  hid_t mem_space = check_hdf5(H5Screate_simple(1, &mem_dims, nullptr));
+  cleanup cleanup_mem_space([=] { H5Sclose(mem_space); });
+  if (elements) {
+    check_hdf5(H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start.data(), /*stride*/ nullptr, count.data(),
+                                   /*block*/ nullptr));
+  } else {
+    check_hdf5(H5Sselect_none(file_space));
+    check_hdf5(H5Sselect_none(mem_space));
+  }
+
+  hid_t xfer = check_hdf5(H5Pcreate(H5P_DATASET_XFER));
+  cleanup cleanup_xfer([=] { H5Pclose(xfer); });
+  if (collective) H5Pset_dxpl_mpio(xfer, H5FD_MPIO_COLLECTIVE);
+  check_hdf5(H5Dwrite(dset, type, mem_space, file_space, xfer, buffer));
+}
+}  // namespace
+
+uint64_t config_hash(std::string const& config) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : config) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+compressed_archive::compressed_archive(std::string const& path, std::string const& config, MPI_Comm comm,
+                                       bool lockstep, io_profile const& profile)
+    : comm(comm), lockstep(lockstep), hash(config_hash(config)), done_header{done_marker, 0} {
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  hid_t fapl = check_hdf5(H5Pcreate(H5P_FILE_ACCESS));
+  cleanup cleanup_fapl([&] { H5Pclose(fapl); });
+  if (lockstep) {
+    profile.apply(fapl, comm);
+    create(path, config, fapl);
+    return;
+  }
+
+  // a rank that cannot create the file must not leave the others sending to it
+  int created = 1;
+  if (rank == 0) {
+    try {
+      profile.apply_serial(fapl);
+      create(path, config, fapl);
+    } catch (std::exception const&) {
+      created = 0;
+    }
+  }
+  MPI_Bcast(&created, 1, MPI_INT, 0, comm);
+  if (!created) {
+    if (index_dset != H5I_INVALID_HID) H5Dclose(index_dset);
+    if (bytes_dset != H5I_INVALID_HID) H5Dclose(bytes_dset);
+    if (file != H5I_INVALID_HID) H5Fclose(file);
+    throw std::runtime_error("failed to create " + path);
+  }
+}
+
+void compressed_archive::create(std::string const& path, std::string const& config, hid_t fapl) {
+  file = check_hdf5(H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl));
+
+  bytes_dset = create_extensible(file, "compressed", H5T_NATIVE_UINT8, 1, &bytes_chunk);
+  std::array<hsize_t, 2> const index_chunk_dims{index_chunk, index_columns};
+  index_dset = create_extensible(file, "index", H5T_NATIVE_UINT64, 2, index_chunk_dims.data());
+
+  hid_t str_type = check_hdf5(H5Tcopy(H5T_C_S1));
+  cleanup cleanup_str_type([=] { H5Tclose(str_type); });
+  check_hdf5(H5Tset_size(str_type, std::max<size_t>(config.size(), 1)));
+  hid_t scalar = check_hdf5(H5Screate(H5S_SCALAR));
+  cleanup cleanup_scalar([=] { H5Sclose(scalar); });
+  hid_t attr = check_hdf5(H5Acreate(file, "config", str_type, scalar, H5P_DEFAULT, H5P_DEFAULT));
+  cleanup cleanup_attr([=] { H5Aclose(attr); });
+  check_hdf5(H5Awrite(attr, str_type, config.c_str()));
+}
+
+compressed_archive::~compressed_archive() {
+  for (auto& pending : sends) {
+    MPI_Waitall(3, pending.requests, MPI_STATUSES_IGNORE);
+  }
+  if (index_dset != H5I_INVALID_HID) H5Dclose(index_dset);
+  if (bytes_dset != H5I_INVALID_HID) H5Dclose(bytes_dset);
+  if (file != H5I_INVALID_HID) H5Fclose(file);
+}
+
+void compressed_archive::append(uint64_t first_event, uint64_t n_events, pressio_data const& compressed) {
+  std::vector<archive_entry> entries;
+  uint64_t const length = n_events ? compressed.size_in_bytes() : 0;
+  if (n_events) {
+    entries.push_back(archive_entry{first_event, n_events, 0, length, hash});
+  }
+  if (lockstep) {
+    write_entries(entries, compressed.data(), length);
+  } else {
+    append_entries(entries, compressed.data(), length);
+  }
+}
+
+void compressed_archive::append(std::vector<uint64_t> const& first_events, std::vector<uint64_t> const& n_events,
+                                std::vector<pressio_data const*> const& streams) {
+  std::vector<archive_entry> entries;
+  // offsets are relative to the start of the concatenated streams
+  std::vector<uint8_t> bytes;
+  for (size_t k = 0; k < streams.size(); ++k) {
+    if (!n_events[k]) continue;
+    uint64_t const length = streams[k]->size_in_bytes();
+    entries.push_back(archive_entry{first_events[k], n_events[k], bytes.size(), length, hash});
+    auto stream = static_cast<uint8_t const*>(streams[k]->data());
+    bytes.insert(bytes.end(), stream, stream + length);
+  }
+  if (lockstep) {
+    write_entries(entries, bytes.data(), bytes.size());
+  } else {
+    append_entries(entries, bytes.data(), bytes.size());
+  }
+}
+
+void compressed_archive::append_entries(std::vector<archive_entry>& entries, void const* bytes, uint64_t length) {
+  if (!entries.empty()) {
+    if (rank == 0) {
+      write_serial(entries, bytes, length);
+    } else {
+      // the caller reuses its buffers, so the streams are copied until the sends complete
+      auto& pending = sends.emplace_back();
+      pending.header[0] = entries.size();
+      pending.header[1] = length;
+      pending.entries = entries;
+      auto const* first = static_cast<uint8_t const*>(bytes);
+      pending.bytes.assign(first, first + length);
+      MPI_Isend(pending.header, 2, MPI_UINT64_T, 0, header_tag, comm, &pending.requests[0]);
+      MPI_Isend(pending.entries.data(), static_cast<int>(pending.entries.size() * index_columns), MPI_UINT64_T, 0,
+                entries_tag, comm, &pending.requests[1]);
+      MPI_Isend(pending.bytes.data(), static_cast<int>(pending.bytes.size()), MPI_BYTE, 0, bytes_tag, comm,
+                &pending.requests[2]);
+    }
+  }
+  progress();
+}
+
+void compressed_archive::write_serial(std::vector<archive_entry>& entries, void const* bytes, uint64_t length) {
+  // offsets are relative to bytes until they are placed after the streams already in the archive
+  for (auto& entry : entries) {
+    entry.offset += archive_bytes;
+  }
+  std::array<hsize_t, 2> bytes_dims{archive_bytes + length, 0};
+  std::array<hsize_t, 2> index_dims{archive_entries + entries.size(), index_columns};
+  check_hdf5(H5Dset_extent(bytes_dset, bytes_dims.data()));
+  check_hdf5(H5Dset_extent(index_dset, index_dims.data()));
+  write_rows(bytes_dset, H5T_NATIVE_UINT8, {archive_bytes, 0}, {length, 0}, bytes, /*collective*/ false);
+  write_rows(index_dset, H5T_NATIVE_UINT64, {archive_entries, 0}, {entries.size(), index_columns}, entries.data(),
+             /*collective*/ false);
+  archive_bytes += length;
+  archive_entries += entries.size();
+}
+
+bool compressed_archive::receive(bool wait) {
+  MPI_Status status;
+  int flag = 1;
+  if (wait) {
+    MPI_Probe(MPI_ANY_SOURCE, header_tag, comm, &status);
+  } else {
+    MPI_Iprobe(MPI_ANY_SOURCE, header_tag, comm, &flag, &status);
+  }
+  if (!flag) return false;
+  uint64_t header[2];
+  MPI_Recv(header, 2, MPI_UINT64_T, status.MPI_SOURCE, header_tag, comm, MPI_STATUS_IGNORE);
+  if (header[0] == done_marker) {
+    ++senders_done;
+    return true;
+  }
+  // messages from one rank are not overtaken, so these are the streams announced by the header
+  received_entries.resize(header[0]);
+  received_bytes.resize(header[1]);
+  MPI_Recv(received_entries.data(), static_cast<int>(header[0] * index_columns), MPI_UINT64_T, status.MPI_SOURCE,
+           entries_tag, comm, MPI_STATUS_IGNORE);
+  MPI_Recv(received_bytes.data(), static_cast<int>(header[1]), MPI_BYTE, status.MPI_SOURCE, bytes_tag, comm,
+           MPI_STATUS_IGNORE);
+  write_serial(received_entries, received_bytes.data(), received_bytes.size());
+  return true;
+}
+
+void compressed_archive::progress() {
+  if (lockstep) return;
+  for (auto it = sends.begin(); it != sends.end();) {
+    int complete = 0;
+    MPI_Testall(3, it->requests, &complete, MPI_STATUSES_IGNORE);
+    if (!complete) break;
+    it = sends.erase(it);
+  }
+  if (rank != 0) return;
+  while (receive(false)) {
+  }
+}
+
+void compressed_archive::finish() {
+  if (lockstep) return;
+  if (rank == 0) {
+    while (senders_done < size - 1) {
+      receive(true);
+    }
+  } else {
+    MPI_Request done_request;
+    MPI_Isend(done_header, 2, MPI_UINT64_T, 0, header_tag, comm, &done_request);
+    MPI_Wait(&done_request, MPI_STATUS_IGNORE);
+  }
+  for (auto& pending : sends) {
+    MPI_Waitall(3, pending.requests, MPI_STATUSES_IGNORE);
+  }
+  sends.clear();
+  // every rank reports the size of the archive, as with lockstep schedules
+  std::array<uint64_t, 2> totals{archive_bytes, archive_entries};
+  MPI_Bcast(totals.data(), totals.size(), MPI_UINT64_T, 0, comm);
+  archive_bytes = totals[0];
+  archive_entries = totals[1];
+}
+
+void compressed_archive::write_entries(std::vector<archive_entry>& entries, void const* bytes,
+                                       uint64_t length) {
+  std::array<uint64_t, 2> local{length, entries.size()};
+  std::array<uint64_t, 2> before{0, 0};
+  std::array<uint64_t, 2> total{0, 0};
+  MPI_Exscan(local.data(), before.data(), local.size(), MPI_UINT64_T, MPI_SUM, comm);
+  MPI_Allreduce(local.data(), total.data(), local.size(), MPI_UINT64_T, MPI_SUM, comm);
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  // the receive buffer of MPI_Exscan is undefined on rank 0
+  if (rank == 0) before = {0, 0};
+  if (total[1] == 0) return;
+
+  uint64_t const byte_offset = archive_bytes + before[0];
+  for (auto& entry : entries) {
+    entry.offset += byte_offset;
+  }
+
+  std::array<hsize_t, 2> bytes_dims{archive_bytes + total[0], 0};
+  std::array<hsize_t, 2> index_dims{archive_entries + total[1], index_columns};
+  check_hdf5(H5Dset_extent(bytes_dset, bytes_dims.data()));
+  check_hdf5(H5Dset_extent(index_dset, index_dims.data()));
+
+  write_rows(bytes_dset, H5T_NATIVE_UINT8, {byte_offset, 0}, {length, 0}, bytes, /*collective*/ true);
+  static_assert(sizeof(archive_entry) == index_columns * sizeof(uint64_t), "archive_entry must be packed");
+  write_rows(index_dset, H5T_NATIVE_UINT64, {archive_entries + before[1], 0}, {entries.size(), index_columns},
+             entries.data(), /*collective*/ true);
+
+  archive_bytes += total[0];
+  archive_entries += total[1];
+}
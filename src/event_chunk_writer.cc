@@ -0,0 +1,150 @@
+#include "event_chunk_writer.h"
+
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+#include "cleanup.h"
+#include "hdf5_helpers.h"
+#include "roibin_h5filter.h"
+
+namespace {
+constexpr int header_tag = 1201;
+constexpr int chunk_tag = 1202;
+constexpr uint64_t done_marker = std::numeric_limits<uint64_t>::max();
+}  // namespace
+
+event_chunk_writer::event_chunk_writer(std::string const& path, std::vector<hsize_t> const& dims,
+                                       std::string const& config, MPI_Comm comm, io_profile const& profile)
+    : comm(comm), dims(dims.size()), done_header{done_marker, 0} {
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  // a rank that cannot create the file must not leave the others waiting for it
+  int created = 1;
+  if (is_writer()) {
+    try {
+      roibin_h5filter_register();
+
+      hid_t fapl = check_hdf5(H5Pcreate(H5P_FILE_ACCESS));
+      cleanup cleanup_fapl([&] { H5Pclose(fapl); });
+      profile.apply_serial(fapl);
+      file = check_hdf5(H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl));
+
+      hid_t space = check_hdf5(H5Screate_simple(dims.size(), dims.data(), nullptr));
+      cleanup cleanup_space([=] { H5Sclose(space); });
+
+      // one chunk per event
+      std::vector<hsize_t> chunk_dims(dims);
+      chunk_dims.front() = 1;
+      hid_t dcpl = check_hdf5(H5Pcreate(H5P_DATASET_CREATE));
+      cleanup cleanup_dcpl([=] { H5Pclose(dcpl); });
+      check_hdf5(H5Pset_chunk(dcpl, chunk_dims.size(), chunk_dims.data()));
+      auto const cd_values = roibin_h5filter_cd_values(config);
+      check_hdf5(
+          H5Pset_filter(dcpl, roibin_h5filter_id, H5Z_FLAG_MANDATORY, cd_values.size(), cd_values.data()));
+
+      hid_t lcpl = check_hdf5(H5Pcreate(H5P_LINK_CREATE));
+      cleanup cleanup_lcpl([&] { H5Pclose(lcpl); });
+      check_hdf5(H5Pset_create_intermediate_group(lcpl, 1));
+
+      dset = check_hdf5(
+          H5Dcreate(file, "/entry_1/data_1/data", H5T_NATIVE_FLOAT, space, lcpl, dcpl, H5P_DEFAULT));
+    } catch (std::exception const&) {
+      created = 0;
+    }
+  }
+  MPI_Bcast(&created, 1, MPI_INT, 0, comm);
+  if (!created) {
+    if (dset != H5I_INVALID_HID) H5Dclose(dset);
+    if (file != H5I_INVALID_HID) H5Fclose(file);
+    throw std::runtime_error("failed to create " + path);
+  }
+}
+
+event_chunk_writer::~event_chunk_writer() {
+  for (auto& pending : sends) {
+    MPI_Waitall(2, pending.requests, MPI_STATUSES_IGNORE);
+  }
+  if (dset != H5I_INVALID_HID) H5Dclose(dset);
+  if (file != H5I_INVALID_HID) H5Fclose(file);
+}
+
+void event_chunk_writer::write(hsize_t event, void const* chunk, size_t bytes) {
+  std::vector<hsize_t> offset(dims, 0);
+  offset.front() = event;
+  auto const begin = std::chrono::steady_clock::now();
+  check_hdf5(H5Dwrite_chunk(dset, H5P_DEFAULT, /*filters*/ 0, offset.data(), bytes, chunk));
+  counters.write_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  ++counters.writes;
+  counters.bytes_written += bytes;
+}
+
+void event_chunk_writer::write_event(hsize_t event, pressio_data const& chunk) {
+  if (is_writer()) {
+    write(event, chunk.data(), chunk.size_in_bytes());
+  } else {
+    // the caller reuses its chunks, so the bytes are copied until the send completes
+    auto& pending = sends.emplace_back();
+    pending.header[0] = event;
+    pending.header[1] = chunk.size_in_bytes();
+    auto const* bytes = static_cast<char const*>(chunk.data());
+    pending.chunk.assign(bytes, bytes + chunk.size_in_bytes());
+    MPI_Isend(pending.header, 2, MPI_UINT64_T, 0, header_tag, comm, &pending.requests[0]);
+    MPI_Isend(pending.chunk.data(), static_cast<int>(pending.chunk.size()), MPI_BYTE, 0, chunk_tag, comm,
+              &pending.requests[1]);
+  }
+  progress();
+}
+
+bool event_chunk_writer::receive(bool wait) {
+  MPI_Status status;
+  int flag = 1;
+  if (wait) {
+    MPI_Probe(MPI_ANY_SOURCE, header_tag, comm, &status);
+  } else {
+    MPI_Iprobe(MPI_ANY_SOURCE, header_tag, comm, &flag, &status);
+  }
+  if (!flag) return false;
+  uint64_t header[2];
+  MPI_Recv(header, 2, MPI_UINT64_T, status.MPI_SOURCE, header_tag, comm, MPI_STATUS_IGNORE);
+  if (header[0] == done_marker) {
+    ++senders_done;
+    return true;
+  }
+  // messages from one rank are not overtaken, so this is the chunk announced by the header
+  received.resize(header[1]);
+  MPI_Recv(received.data(), static_cast<int>(header[1]), MPI_BYTE, status.MPI_SOURCE, chunk_tag, comm,
+           MPI_STATUS_IGNORE);
+  write(header[0], received.data(), received.size());
+  return true;
+}
+
+void event_chunk_writer::progress() {
+  for (auto it = sends.begin(); it != sends.end();) {
+    int complete = 0;
+    MPI_Testall(2, it->requests, &complete, MPI_STATUSES_IGNORE);
+    if (!complete) break;
+    it = sends.erase(it);
+  }
+  if (!is_writer()) return;
+  while (receive(false)) {
+  }
+}
+
+void event_chunk_writer::finish() {
+  auto const begin = std::chrono::steady_clock::now();
+  if (is_writer()) {
+    while (senders_done < size - 1) {
+      receive(true);
+    }
+  } else {
+    MPI_Request done_request;
+    MPI_Isend(done_header, 2, MPI_UINT64_T, 0, header_tag, comm, &done_request);
+    MPI_Wait(&done_request, MPI_STATUS_IGNORE);
+  }
+  for (auto& pending : sends) {
+    MPI_Waitall(2, pending.requests, MPI_STATUSES_IGNORE);
+  }
+  sends.clear();
+  counters.finish_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
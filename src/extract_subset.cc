@@ -13,19 +13,28 @@
 #include "hdf5_helpers.h"
 #include "roibin_test_version.h"
 
-const std::string usage = R"(roibin_test
-experimental code to test roibin_sz3
-
--c chunk_size
--f cxi_filename
+const std::string usage = R"(extract_subset
+copies a subset of the events of a cxi file to a new file
+
+-b <first> first event to extract (default: 0)
+-c <count> number of events to extract (default: 1)
+-s <stride> extract every stride-th event starting at first (default: 1)
+-f <cxi_filename> filename
+-o <output_file> the file to create (default: roibin.cxi)
+-M <MiB> memory budget per rank; events are streamed in blocks of at most this size (default: 1024)
+-z <level> deflate level of the frames and peak tables, 0 to disable (default: 6)
 -h print this message
 -v print the version information
+
+run with multiple ranks to copy (and compress) disjoint blocks of events in parallel
 )";
 
 struct cmdline_args {
   std::string cxi_filename = "cxic0415_0101.cxi";
   std::string outfile = "roibin.cxi";
-  size_t chunk_size = 1;
+  event_selection events{0, 1, 1};
+  size_t memory_budget = size_t{1024} << 20;
+  unsigned deflate_level = 6;
 };
 
 using namespace std::string_literals;
@@ -34,20 +43,43 @@ cmdline_args parse_args(int argc, char* argv[]) {
   cmdline_args args;
 
   int opt;
-  while ((opt = getopt(argc, argv, "c:hvf:")) != -1) {
+  while ((opt = getopt(argc, argv, "b:c:hvf:M:o:s:z:")) != -1) {
     switch (opt) {
+      case 'b':
+        args.events.first = atoll(optarg);
+        break;
       case 'c':
-        args.chunk_size = atoi(optarg);
-        if (args.chunk_size == 0) {
-          throw std::runtime_error("invalid chunk_size"s + optarg);
+        args.events.count = atoll(optarg);
+        if (args.events.count == 0) {
+          throw std::runtime_error("invalid count "s + optarg);
+        }
+        break;
+      case 's':
+        args.events.stride = atoll(optarg);
+        if (args.events.stride == 0) {
+          throw std::runtime_error("invalid stride "s + optarg);
         }
         break;
       case 'f':
         args.cxi_filename = optarg;
         break;
+      case 'o':
+        args.outfile = optarg;
+        break;
+      case 'M':
+        args.memory_budget = static_cast<size_t>(atoll(optarg)) << 20;
+        if (args.memory_budget == 0) {
+          throw std::runtime_error("invalid memory budget "s + optarg);
+        }
+        break;
+      case 'z':
+        args.deflate_level = atoi(optarg);
+        if (args.deflate_level > 9) {
+          throw std::runtime_error("invalid deflate level "s + optarg);
+        }
+        break;
       case 'h':
         std::cout << usage << std::endl;
-        ;
         exit(0);
         break;
       case 'v':
@@ -60,11 +92,29 @@ cmdline_args parse_args(int argc, char* argv[]) {
   return args;
 }
 
+/**
+ * \returns how many events of dset fit in the memory budget
+ */
+size_t block_events(h5dset const& dset, size_t element_size, size_t memory_budget) {
+  auto dims = dset.get_dims_hsize();
+  size_t const event_bytes =
+      std::accumulate(std::next(dims.begin()), dims.end(), element_size, std::multiplies<>{});
+  return std::max<size_t>(1, memory_budget / event_bytes);
+}
+
 int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  cleanup cleanup_init([&] { MPI_Finalize(); });
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   try {
     auto args = parse_args(argc, argv);
 
-    hid_t cxi = check_hdf5(H5Fopen(args.cxi_filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT));
+    hid_t fapl = check_hdf5(H5Pcreate(H5P_FILE_ACCESS));
+    cleanup cleanup_fapl([&] { H5Pclose(fapl); });
+    check_hdf5(H5Pset_fapl_mpio(fapl, MPI_COMM_WORLD, MPI_INFO_NULL));
+
+    hid_t cxi = check_hdf5(H5Fopen(args.cxi_filename.c_str(), H5F_ACC_RDONLY, fapl));
     cleanup cleanup_cxi([&] { H5Fclose(cxi); });
 
     const char* data_loc = "/entry_1/data_1/data";
@@ -84,7 +134,7 @@ int main(int argc, char* argv[]) {
     // peakYPos -- numEvents x maxPeaks (double)
     // nPeaks -- numEvents (int64_t)
     // data -- numEvents x column x row (float)
-    if (numEvents < args.chunk_size) {
+    if (args.events.first + (args.events.count - 1) * args.events.stride >= numEvents) {
       throw std::runtime_error("too few events");
     }
 
@@ -92,49 +142,52 @@ int main(int argc, char* argv[]) {
     auto peaksy_dims_hsize = posy.get_dims_hsize();
     auto npeaks_dims_hsize = npeaks.get_dims_hsize();
     auto data_dims_hsize = data.get_dims_hsize();
-    std::cout << "peaks x " << printer{peaksx_dims_hsize} << "peaks y "
-              << printer{peaksy_dims_hsize} << "npeaks " << printer{npeaks_dims_hsize} << "data "
-              << printer{data_dims_hsize} << std::endl;
-
-    auto work_peaksx_dims_hsize = std::vector<hsize_t>{args.chunk_size, maxPeaks};
-    auto work_peaksy_dims_hsize =
-        std::vector<hsize_t>{static_cast<hsize_t>(args.chunk_size), maxPeaks};
-    auto work_npeaks_dims_hsize = std::vector<hsize_t>{static_cast<hsize_t>(args.chunk_size)};
-    auto work_data_dims_hsize = std::vector<hsize_t>{static_cast<hsize_t>(args.chunk_size),
-                                                     data_dims_hsize[1], data_dims_hsize[2]};
+    if (rank == 0) {
+      std::cout << "peaks x " << printer{peaksx_dims_hsize} << "peaks y " << printer{peaksy_dims_hsize} << "npeaks "
+                << printer{npeaks_dims_hsize} << "data " << printer{data_dims_hsize} << std::endl;
+    }
 
     auto chunk_data_hsize =
         std::vector<hsize_t>{static_cast<hsize_t>(1), data_dims_hsize[1], data_dims_hsize[2]};
     auto chunk_peak_hsize = std::vector<hsize_t>{static_cast<hsize_t>(1), maxPeaks};
 
     {
-      hid_t output_file = check_hdf5(
-          H5Fcreate(args.outfile.c_str(), 0, /*create*/ H5P_DEFAULT, /*access*/ H5P_DEFAULT));
+      hid_t output_file = check_hdf5(H5Fcreate(args.outfile.c_str(), 0, /*create*/ H5P_DEFAULT, /*access*/ fapl));
       cleanup output_file_cleanup([&] { H5Fclose(output_file); });
 
       hid_t data_dcpl = check_hdf5(H5Pcreate(H5P_DATASET_CREATE));
       cleanup cleanup_dapl([&] { H5Pclose(data_dcpl); });
       check_hdf5(H5Pset_chunk(data_dcpl, chunk_data_hsize.size(), chunk_data_hsize.data()));
-      check_hdf5(H5Pset_deflate(data_dcpl, 6));
 
       hid_t peak_dcpl = check_hdf5(H5Pcreate(H5P_DATASET_CREATE));
       cleanup cleanup_peak_dapl([&] { H5Pclose(peak_dcpl); });
       check_hdf5(H5Pset_chunk(peak_dcpl, chunk_peak_hsize.size(), chunk_peak_hsize.data()));
-      check_hdf5(H5Pset_deflate(peak_dcpl, 6));
-
-      std::clog << "copy data" << std::endl;
-      copy<float>(data, work_data_dims_hsize, data_dcpl, output_file, data_loc);
-      std::clog << "copy peakx" << std::endl;
-      copy<double>(posx, work_peaksx_dims_hsize, peak_dcpl, output_file, peakx_loc);
-      std::clog << "copy peaky" << std::endl;
-      copy<double>(posy, work_peaksy_dims_hsize, peak_dcpl, output_file, peaky_loc);
-      std::clog << "copy npeak" << std::endl;
-      copy<int64_t>(npeaks, work_npeaks_dims_hsize, H5P_DEFAULT, output_file, npeak_loc);
-      std::clog << "done" << std::endl;
+      if (args.deflate_level) {
+        check_hdf5(H5Pset_deflate(data_dcpl, args.deflate_level));
+        check_hdf5(H5Pset_deflate(peak_dcpl, args.deflate_level));
+      }
+
+      auto log = [&](const char* msg) {
+        if (rank == 0) std::clog << msg << std::endl;
+      };
+      log("copy data");
+      copy<float>(data, args.events, block_events(data, sizeof(float), args.memory_budget), data_dcpl, output_file,
+                  data_loc, MPI_COMM_WORLD);
+      log("copy peakx");
+      copy<double>(posx, args.events, block_events(posx, sizeof(double), args.memory_budget), peak_dcpl, output_file,
+                   peakx_loc, MPI_COMM_WORLD);
+      log("copy peaky");
+      copy<double>(posy, args.events, block_events(posy, sizeof(double), args.memory_budget), peak_dcpl, output_file,
+                   peaky_loc, MPI_COMM_WORLD);
+      log("copy npeak");
+      copy<int64_t>(npeaks, args.events, block_events(npeaks, sizeof(int64_t), args.memory_budget), H5P_DEFAULT,
+                    output_file, npeak_loc, MPI_COMM_WORLD);
+      log("done");
     }
 
   } catch (std::exception const& ex) {
     std::cout << ex.what() << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
   }
   return 0;
 }
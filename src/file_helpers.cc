@@ -2,13 +2,22 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstring>
+#include <exception>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "cleanup.h"
 
@@ -24,33 +33,190 @@ std::string posix_error::build_msg(const char* user_msg) {
   return full_msg.str();
 }
 
-void copy_file(std::string const& src, std::string const& dest) {
-  struct stat src_stat;
-  int src_fd = open(src.c_str(), O_RDONLY);
-  if (src_fd < 0) {
-    throw posix_error("failed to stat source file");
+copy_strategy parse_copy_strategy(std::string const& name) {
+  for (auto strategy : {copy_strategy::automatic, copy_strategy::reflink, copy_strategy::copy_file_range,
+                        copy_strategy::sendfile}) {
+    if (name == copy_strategy_name(strategy)) return strategy;
   }
-  cleanup cleanup_src([&] { close(src_fd); });
+  throw std::runtime_error("invalid copy strategy " + name);
+}
+
+const char* copy_strategy_name(copy_strategy strategy) {
+  switch (strategy) {
+    case copy_strategy::automatic:
+      return "auto";
+    case copy_strategy::reflink:
+      return "reflink";
+    case copy_strategy::copy_file_range:
+      return "copy_file_range";
+    case copy_strategy::sendfile:
+      return "sendfile";
+  }
+  return "unknown";
+}
 
-  if (fstat(src_fd, &src_stat) < 0) {
+uint64_t file_size(std::string const& path) {
+  struct stat path_stat;
+  if (stat(path.c_str(), &path_stat) < 0) {
     throw posix_error("failed to stat source file");
   }
+  return path_stat.st_size;
+}
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point begin) {
+  return std::chrono::duration<double>(clock_type::now() - begin).count();
+}
+
+// copy_file_range is not supported across filesystems on older kernels or by some filesystems at all
+bool copy_file_range_unsupported(int err) {
+  return err == EXDEV || err == ENOSYS || err == EOPNOTSUPP || err == EINVAL;
+}
+
+// copies [offset, offset+length) using the given file descriptors; returns the strategy used
+copy_strategy copy_range_fd(int src_fd, int dest_fd, uint64_t offset, uint64_t length, copy_strategy strategy) {
+  off_t src_offset = offset;
+  off_t dest_offset = offset;
+  off_t const end = offset + length;
+  while (strategy == copy_strategy::copy_file_range && src_offset < end) {
+    auto copied = ::copy_file_range(src_fd, &src_offset, dest_fd, &dest_offset, end - src_offset, 0);
+    if (copied < 0 && copy_file_range_unsupported(errno) && src_offset == static_cast<off_t>(offset)) {
+      strategy = copy_strategy::sendfile;
+    } else if (copied < 0) {
+      throw posix_error("copy_file_range failed");
+    } else if (copied == 0) {
+      throw std::runtime_error("unexpected end of source file");
+    }
+  }
+  if (strategy == copy_strategy::sendfile && src_offset < end) {
+    // sendfile writes at the file position of the destination
+    if (lseek(dest_fd, dest_offset, SEEK_SET) < 0) {
+      throw posix_error("failed to seek dest file");
+    }
+    while (src_offset < end) {
+      auto written = sendfile(dest_fd, src_fd, &src_offset, end - src_offset);
+      if (written < 0) {
+        throw posix_error("sendfile failed");
+      } else if (written == 0) {
+        throw std::runtime_error("unexpected end of source file");
+      }
+    }
+  }
+  return strategy;
+}
 
+copy_strategy copy_range_file(std::string const& source, std::string const& dest, uint64_t offset,
+                              uint64_t length, copy_strategy strategy) {
+  int src_fd = open(source.c_str(), O_RDONLY);
+  if (src_fd < 0) {
+    throw posix_error("failed to open source file");
+  }
+  cleanup cleanup_src([&] { close(src_fd); });
+  int dest_fd = open(dest.c_str(), O_WRONLY);
+  if (dest_fd < 0) {
+    throw posix_error("failed to open dest file");
+  }
+  cleanup cleanup_dest([&] { close(dest_fd); });
+  auto used = copy_range_fd(src_fd, dest_fd, offset, length, strategy);
+  // the ranges may be copied from several nodes, so each writer syncs its own part
+  if (fdatasync(dest_fd) < 0) {
+    throw posix_error("failed to sync dest file");
+  }
+  return used;
+}
+}  // namespace
+
+bool reflink_file(std::string const& source, std::string const& dest) {
+  int src_fd = open(source.c_str(), O_RDONLY);
+  if (src_fd < 0) {
+    throw posix_error("failed to open source file");
+  }
+  cleanup cleanup_src([&] { close(src_fd); });
   int dest_fd = open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
   if (dest_fd < 0) {
     throw posix_error("failed to open dest file");
   }
   cleanup cleanup_dest([&] { close(dest_fd); });
-  if (ftruncate(dest_fd, src_stat.st_size)) {
+  if (ioctl(dest_fd, FICLONE, src_fd) < 0) {
+    if (errno == EOPNOTSUPP || errno == EXDEV || errno == EINVAL || errno == ENOTTY) {
+      return false;
+    }
+    throw posix_error("reflink failed");
+  }
+  return true;
+}
+
+void create_file(std::string const& path, uint64_t size) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    throw posix_error("failed to open dest file");
+  }
+  cleanup cleanup_fd([&] { close(fd); });
+  if (ftruncate(fd, size)) {
     throw posix_error("failed to set the size of the file");
   }
+}
+
+copy_stats copy_file_part(std::string const& source, std::string const& dest, uint64_t offset, uint64_t length,
+                          copy_strategy strategy, unsigned threads) {
+  if (strategy != copy_strategy::copy_file_range && strategy != copy_strategy::sendfile) {
+    throw std::runtime_error("ranges can only be copied with copy_file_range or sendfile");
+  }
+  auto const begin = clock_type::now();
+  threads = std::max(threads, 1u);
+  // split on 1MiB boundaries so threads do not share filesystem blocks
+  constexpr uint64_t alignment = 1 << 20;
+  uint64_t const per_thread = (length / threads + alignment - 1) / alignment * alignment;
+
+  std::vector<copy_strategy> used(threads, strategy);
+  std::vector<std::exception_ptr> errors(threads);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    uint64_t const thread_offset = std::min(length, t * per_thread);
+    uint64_t const thread_length = std::min(length - thread_offset, per_thread);
+    if (thread_length == 0) break;
+    workers.emplace_back([&, t, thread_offset, thread_length] {
+      try {
+        used[t] = copy_range_file(source, dest, offset + thread_offset, thread_length, strategy);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (auto const& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+
+  copy_stats stats;
+  stats.strategy = std::find(used.begin(), used.end(), copy_strategy::sendfile) != used.end()
+                       ? copy_strategy::sendfile
+                       : strategy;
+  stats.bytes = length;
+  stats.seconds = seconds_since(begin);
+  return stats;
+}
 
-  off_t offset = 0;
-  while (offset < src_stat.st_size) {
-    auto written = sendfile(dest_fd, src_fd, &offset, src_stat.st_size - offset);
-    if (written == -1) {
-      throw posix_error("sendfile failed");
+copy_stats copy_file(std::string const& src, std::string const& dest, copy_strategy strategy, unsigned threads) {
+  auto const begin = clock_type::now();
+  uint64_t const size = file_size(src);
+
+  if (strategy == copy_strategy::automatic || strategy == copy_strategy::reflink) {
+    if (reflink_file(src, dest)) {
+      return copy_stats{copy_strategy::reflink, size, seconds_since(begin)};
+    } else if (strategy == copy_strategy::reflink) {
+      throw std::runtime_error("the filesystem does not support reflinks");
     }
+    strategy = copy_strategy::copy_file_range;
   }
-  fsync(dest_fd);
+
+  create_file(dest, size);
+
+  auto stats = copy_file_part(src, dest, 0, size, strategy, threads);
+  stats.seconds = seconds_since(begin);
+  return stats;
 }
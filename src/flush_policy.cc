@@ -0,0 +1,79 @@
+#include "flush_policy.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+volatile std::sig_atomic_t flush_requested = 0;
+extern "C" void request_flush(int) { flush_requested = 1; }
+}  // namespace
+
+flush_policy flush_policy::parse(std::string const& spec) {
+  flush_policy result;
+  result.spec = spec;
+  auto const colon = spec.find(':');
+  auto const name = spec.substr(0, colon);
+  auto const value = (colon == std::string::npos) ? std::string{} : spec.substr(colon + 1);
+  if (name == "always" && value.empty()) {
+    result.policy = kind::always;
+  } else if (name == "close" && value.empty()) {
+    result.policy = kind::close;
+  } else if (name == "chunks" && !value.empty()) {
+    result.policy = kind::chunks;
+    result.every_chunks = strtoull(value.c_str(), nullptr, 10);
+    if (result.every_chunks == 0) {
+      throw std::runtime_error("invalid flush chunk count "s + value);
+    }
+  } else if (name == "seconds" && !value.empty()) {
+    result.policy = kind::seconds;
+    result.every_seconds = strtod(value.c_str(), nullptr);
+    if (!(result.every_seconds > 0)) {
+      throw std::runtime_error("invalid flush interval "s + value);
+    }
+  } else if (name == "signal" && value.empty()) {
+    result.policy = kind::signal;
+    std::signal(SIGUSR1, request_flush);
+  } else {
+    throw std::runtime_error("invalid flush policy "s + spec);
+  }
+  return result;
+}
+
+bool flush_policy::due(MPI_Comm comm) {
+  ++chunks_since_flush;
+  bool flush = false;
+  switch (policy) {
+    case kind::always:
+      flush = true;
+      break;
+    case kind::close:
+      flush = false;
+      break;
+    case kind::chunks:
+      flush = chunks_since_flush >= every_chunks;
+      break;
+    case kind::seconds:
+    case kind::signal: {
+      // ranks observe the clock and signals independently, so agree before the collective flush
+      int local = 0;
+      if (policy == kind::seconds) {
+        local = std::chrono::duration<double>(clock::now() - last_flush).count() >= every_seconds;
+      } else {
+        local = flush_requested;
+      }
+      int any = 0;
+      MPI_Allreduce(&local, &any, 1, MPI_INT, MPI_LOR, comm);
+      flush = any;
+      break;
+    }
+  }
+  if (flush) {
+    chunks_since_flush = 0;
+    last_flush = clock::now();
+    flush_requested = 0;
+  }
+  return flush;
+}
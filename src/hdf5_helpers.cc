@@ -2,10 +2,20 @@
 
 #include <libpressio_ext/cpp/printers.h>
 
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
 
 #include "debug_helpers.h"
 
+using namespace std::string_literals;
+
 hid_t check_hdf5(hid_t err) {
   if (err < 0) {
     throw std::runtime_error("failed operation");
@@ -47,76 +57,333 @@ hid_t pressio_to_hdf5_native_type(pressio_dtype type) {
   }
 }
 
-void write(h5dset const& dset, std::vector<hsize_t> const& start, std::vector<hsize_t> const& count,
-           pressio_data& data, size_t work_items, bool debug) {
-  if(debug) {
-    auto dims = data.dimensions();
-    std::reverse(dims.begin(), dims.end());
-    logger("pre-write: ", std::boolalpha , static_cast<bool>(work_items) , " dims=" , printer{dims}
-              , " start=" , printer{start} , " count=" , printer{count}, " dtype=" , data.dtype());
-  }
-  hid_t file_space = check_hdf5(H5Scopy(dset.space));
-  cleanup cleanup_file_space([=] { H5Sclose(file_space); });
-  check_hdf5(H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start.data(),
-                                 /*stride*/ nullptr, count.data(), /*block*/ nullptr));
+h5transfer::h5transfer(h5dset const& dset, H5FD_mpio_xfer_t xfer_mode)
+    : dset(&dset),
+      file_space(check_hdf5(H5Scopy(dset.space)), H5Sclose),
+      xfer(check_hdf5(H5Pcreate(H5P_DATASET_XFER)), H5Pclose) {
+  check_hdf5(H5Pset_dxpl_mpio(xfer.get(), xfer_mode));
+}
 
-  if(debug) logger("write-elems: data=", data.num_elements() , " space=", H5Sget_select_npoints(file_space), " work-items=" , work_items, "start=", printer{start});
+void h5transfer::select(std::vector<hsize_t> const& start, std::vector<hsize_t> const& count, pressio_data& data,
+                        size_t work_items, const char* op) {
+  check_hdf5(H5Sselect_hyperslab(file_space.get(), H5S_SELECT_SET, start.data(),
+                                 /*stride*/ nullptr, count.data(), /*block*/ nullptr));
   if (work_items &&
-      (data.num_elements() != static_cast<size_t>(H5Sget_select_npoints(file_space)))) {
+      (data.num_elements() != static_cast<size_t>(H5Sget_select_npoints(file_space.get())))) {
     auto dims = data.dimensions();
     std::reverse(dims.begin(), dims.end());
     std::cout << std::boolalpha << static_cast<bool>(work_items) << " dims=" << printer{dims}
               << " start=" << printer{start} << " count=" << printer{count} << std::endl;
-    throw std::runtime_error("write space size does not equal buffer size " + std::to_string(work_items) +
-                             " " + std::to_string(data.num_elements()) + " " +
-                             std::to_string(H5Sget_select_npoints(file_space)));
+    throw std::runtime_error(std::string(op) + " space size does not equal buffer size " +
+                             std::to_string(work_items) + " " + std::to_string(data.num_elements()) + " " +
+                             std::to_string(H5Sget_select_npoints(file_space.get())));
   }
-  hid_t mem_space = check_hdf5(H5Screate_simple(count.size(), count.data(), nullptr));
-  hid_t xfer = check_hdf5(H5Pcreate(H5P_DATASET_XFER));
-  H5Pset_dxpl_mpio(xfer, H5FD_MPIO_COLLECTIVE);
-  cleanup cleanup_xfer([=] { H5Pclose(xfer); });
+
+  // reshape the memory dataspace only when the shape of the transfer changes
+  if (!mem_space) {
+    mem_space = h5handle(check_hdf5(H5Screate_simple(count.size(), count.data(), nullptr)), H5Sclose);
+    mem_dims = count;
+  } else if (mem_dims != count) {
+    check_hdf5(H5Sset_extent_simple(mem_space.get(), count.size(), count.data(), nullptr));
+    mem_dims = count;
+  }
+}
+
+void h5transfer::write(std::vector<hsize_t> const& start, std::vector<hsize_t> const& count, pressio_data& data,
+                       size_t work_items, bool debug) {
+  if(debug) {
+    auto dims = data.dimensions();
+    std::reverse(dims.begin(), dims.end());
+    logger("pre-write: ", std::boolalpha , static_cast<bool>(work_items) , " dims=" , printer{dims}
+              , " start=" , printer{start} , " count=" , printer{count}, " dtype=" , data.dtype());
+  }
+  select(start, count, data, work_items, "write");
+  if(debug) logger("write-elems: data=", data.num_elements() , " space=", H5Sget_select_npoints(file_space.get()), " work-items=" , work_items, "start=", printer{start});
   if (debug) logger("start-write " , printer{start});
-  
-  check_hdf5(H5Dwrite(dset.dset, pressio_to_hdf5_native_type(data.dtype()), mem_space, file_space,
-                     xfer, data.data()));
+  check_hdf5(H5Dwrite(dset->dset, pressio_to_hdf5_native_type(data.dtype()), mem_space.get(), file_space.get(),
+                      xfer.get(), data.data()));
   if (debug) logger("end-write " , printer{start});
 }
 
-void read(h5dset const& dset, std::vector<hsize_t> const& start, std::vector<hsize_t> const& count,
-          pressio_data& data, size_t work_items, bool debug) {
+void h5transfer::read(std::vector<hsize_t> const& start, std::vector<hsize_t> const& count, pressio_data& data,
+                      size_t work_items, bool debug) {
   if(debug) {
     auto dims = data.dimensions();
     std::reverse(dims.begin(), dims.end());
     logger("pre-read: ", std::boolalpha , static_cast<bool>(work_items) , " dims=" , printer{dims}
               , " start=" , printer{start} , " count=" , printer{count}, " dtype=" , data.dtype());
   }
+  select(start, count, data, work_items, "read");
+  if(debug) logger("read-elems: data=", data.num_elements() , " space=", H5Sget_select_npoints(file_space.get()), " work-items=" , work_items, "start=", printer{start});
+  if (debug) logger("start-read " , printer{start});
+  check_hdf5(H5Dread(dset->dset, pressio_to_hdf5_native_type(data.dtype()), mem_space.get(), file_space.get(),
+                     xfer.get(), data.data()));
+  if (debug) logger("end-read " , printer{start});
+}
+
+void write(h5dset const& dset, std::vector<hsize_t> const& start, std::vector<hsize_t> const& count,
+           pressio_data& data, size_t work_items, bool debug, H5FD_mpio_xfer_t xfer_mode) {
+  h5transfer(dset, xfer_mode).write(start, count, data, work_items, debug);
+}
+
+void read(h5dset const& dset, std::vector<hsize_t> const& start, std::vector<hsize_t> const& count,
+          pressio_data& data, size_t work_items, bool debug, H5FD_mpio_xfer_t xfer_mode) {
+  h5transfer(dset, xfer_mode).read(start, count, data, work_items, debug);
+}
+
+h5layout get_layout(h5dset const& dset) {
+  h5layout layout;
+  hid_t dcpl = check_hdf5(H5Dget_create_plist(dset.dset));
+  cleanup cleanup_dcpl([=] { H5Pclose(dcpl); });
+  if (H5Pget_layout(dcpl) != H5D_CHUNKED) return layout;
+  layout.chunked = true;
+  layout.chunk_dims.resize(check_hdf5(H5Sget_simple_extent_ndims(dset.space)));
+  check_hdf5(H5Pget_chunk(dcpl, layout.chunk_dims.size(), layout.chunk_dims.data()));
+  layout.filters = check_hdf5(H5Pget_nfilters(dcpl));
+  return layout;
+}
+
+bool read_chunks_direct(h5dset const& dset, h5layout const& layout, hsize_t first_row, size_t rows,
+                        pressio_data& data) {
+  if (!layout.chunked || layout.filters != 0 || rows == 0) return false;
+  auto const dims = dset.get_dims_hsize();
+  if (!std::equal(dims.begin() + 1, dims.end(), layout.chunk_dims.begin() + 1)) return false;
+  hsize_t const chunk_rows = layout.chunk_dims.front();
+  // a partial chunk at the end of the dataset is still stored as a whole chunk
+  if (first_row % chunk_rows != 0 || rows % chunk_rows != 0) return false;
+
+  // chunks are copied without type conversion, so the stored type must be the type of the buffer
+  hid_t stored_type = check_hdf5(H5Dget_type(dset.dset));
+  cleanup cleanup_stored_type([=] { H5Tclose(stored_type); });
+  if (H5Tequal(stored_type, pressio_to_hdf5_native_type(data.dtype())) <= 0) return false;
+
+  size_t const chunk_bytes = data.size_in_bytes() / rows * chunk_rows;
+  std::vector<hsize_t> offset(dims.size(), 0);
+  for (hsize_t row = first_row; row < first_row + rows; row += chunk_rows) {
+    offset.front() = row;
+    hsize_t stored_bytes = 0;
+    if (H5Dget_chunk_storage_size(dset.dset, offset.data(), &stored_bytes) < 0 || stored_bytes != chunk_bytes) {
+      return false;
+    }
+  }
+
+  auto* out = static_cast<uint8_t*>(data.data());
+  for (hsize_t row = first_row; row < first_row + rows; row += chunk_rows) {
+    offset.front() = row;
+    uint32_t filter_mask = 0;
+    check_hdf5(H5Dread_chunk(dset.dset, H5P_DEFAULT, offset.data(), &filter_mask, out));
+    out += chunk_bytes;
+  }
+  return true;
+}
+
+size_t read_row_prefixes(h5dset const& dset, hsize_t first_row, int64_t const* lengths, size_t rows,
+                         pressio_data& data, H5FD_mpio_xfer_t xfer_mode) {
   hid_t file_space = check_hdf5(H5Scopy(dset.space));
   cleanup cleanup_space([=] { H5Sclose(file_space); });
-  check_hdf5(H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start.data(),
-                                 /*stride*/ nullptr, count.data(),
-                                 /*block*/ nullptr));
-
-  if(debug) logger("read-elems: data=", data.num_elements() , " space=", H5Sget_select_npoints(file_space), " work-items=" , work_items, "start=", printer{start});
-  if (work_items &&
-      (data.num_elements() != static_cast<size_t>(H5Sget_select_npoints(file_space)))) {
-    auto dims = data.dimensions();
-    std::reverse(dims.begin(), dims.end());
-    std::cout << std::boolalpha << static_cast<bool>(work_items) << " dims=" << printer{dims}
-              << " start=" << printer{start} << " count=" << printer{count} << std::endl;
-    throw std::runtime_error("read space size does not equal buffer size " + std::to_string(work_items) +
-                             " " + std::to_string(data.num_elements()) + " " +
-                             std::to_string(H5Sget_select_npoints(file_space)));
+  check_hdf5(H5Sselect_none(file_space));
+  hsize_t total = 0;
+  for (size_t k = 0; k < rows; ++k) {
+    if (lengths[k] <= 0) continue;
+    std::array<hsize_t, 2> start{first_row + k, 0};
+    std::array<hsize_t, 2> count{1, static_cast<hsize_t>(lengths[k])};
+    check_hdf5(H5Sselect_hyperslab(file_space, H5S_SELECT_OR, start.data(), /*stride*/ nullptr,
+                                   count.data(), /*block*/ nullptr));
+    total += lengths[k];
+  }
+  if (data.num_elements() < total) {
+    throw std::runtime_error("read buffer is smaller than the selected rows " +
+                             std::to_string(data.num_elements()) + " " + std::to_string(total));
   }
 
-  hid_t mem_space = check_hdf5(H5Screate_simple(count.size(), count.data(), nullptr));
+  // a dataspace may not be empty, so select nothing from a single element instead
+  hsize_t mem_dims = std::max<hsize_t>(total, 1);
+  hid_t mem_space = check_hdf5(H5Screate_simple(1, &mem_dims, nullptr));
+  cleanup cleanup_mem_space([=] { H5Sclose(mem_space); });
+  if (total == 0) check_hdf5(H5Sselect_none(mem_space));
 
   hid_t xfer = check_hdf5(H5Pcreate(H5P_DATASET_XFER));
-  H5Pset_dxpl_mpio(xfer, H5FD_MPIO_COLLECTIVE);
   cleanup cleanup_xfer([=] { H5Pclose(xfer); });
-  if(debug) {
+  H5Pset_dxpl_mpio(xfer, xfer_mode);
+  check_hdf5(H5Dread(dset.dset, pressio_to_hdf5_native_type(data.dtype()), mem_space, file_space, xfer,
+                     data.data()));
+  return total * pressio_dtype_size(data.dtype());
+}
+
+namespace {
+void copy_attributes(hid_t source, hid_t dest) {
+  hsize_t idx = 0;
+  check_hdf5(H5Aiterate2(
+      source, H5_INDEX_NAME, H5_ITER_NATIVE, &idx,
+      [](hid_t location, const char* name, const H5A_info_t*, void* data) -> herr_t {
+        hid_t dest = *static_cast<hid_t*>(data);
+        hid_t attr = H5Aopen(location, name, H5P_DEFAULT);
+        if (attr < 0) return -1;
+        cleanup cleanup_attr([=] { H5Aclose(attr); });
+        hid_t type = H5Aget_type(attr);
+        cleanup cleanup_type([=] { H5Tclose(type); });
+        hid_t space = H5Aget_space(attr);
+        cleanup cleanup_space([=] { H5Sclose(space); });
+        // the storage size of variable-length values is that of the file's heap references, not of the
+        // memory values that H5Aread returns
+        hssize_t const points = H5Sget_select_npoints(space);
+        if (points < 0) return -1;
+        std::vector<char> value(points * H5Tget_size(type));
+        if (H5Aread(attr, type, value.data()) < 0) return -1;
+        // variable-length values are allocated by H5Aread and must be freed even if the copy fails
+        cleanup reclaim_value([&] { H5Dvlen_reclaim(type, space, H5P_DEFAULT, value.data()); });
+        hid_t copy = H5Acreate2(dest, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+        if (copy < 0) return -1;
+        cleanup cleanup_copy([=] { H5Aclose(copy); });
+        return H5Awrite(copy, type, value.data());
+      },
+      &dest));
+}
+
+// the paths that create_linked_file creates in dest rather than linking to source
+struct created_path {
+  std::map<std::string, created_path> children;
+  // a soft link to recreate, or empty for the dataset itself or a group
+  std::string soft_target;
+};
+
+std::vector<std::string> path_components(std::string const& path) {
+  std::vector<std::string> components;
+  std::stringstream loc(path);
+  for (std::string component; std::getline(loc, component, '/');) {
+    if (!component.empty()) components.push_back(component);
   }
-  if (debug) logger("start-read " , printer{start});
-  check_hdf5(H5Dread(dset.dset, pressio_to_hdf5_native_type(data.dtype()), mem_space, file_space,
-                     xfer, data.data()));
-  if (debug) logger("end-read " , printer{start});
+  return components;
+}
+
+// every soft link in the source file that resolves to data_loc, by its path and its target as written
+std::vector<std::pair<std::string, std::string>> soft_links_to(hid_t source_file, std::string const& data_loc) {
+  struct search {
+    std::string data_loc;
+    std::vector<std::pair<std::string, std::string>> links;
+  } found{data_loc, {}};
+  check_hdf5(H5Lvisit(
+      source_file, H5_INDEX_NAME, H5_ITER_NATIVE,
+      [](hid_t file, const char* name, const H5L_info_t* info, void* data) -> herr_t {
+        if (info->type != H5L_TYPE_SOFT) return 0;
+        auto& found = *static_cast<search*>(data);
+        std::string target(info->u.val_size, '\0');
+        if (H5Lget_val(file, name, target.data(), target.size(), H5P_DEFAULT) < 0) return -1;
+        target.resize(std::strlen(target.c_str()));
+        // relative targets are resolved against the group that holds the link
+        std::string path = "/"s + name;
+        std::string resolved = target;
+        if (resolved.empty() || resolved.front() != '/') {
+          resolved = path.substr(0, path.rfind('/') + 1) + resolved;
+        }
+        if (path_components(resolved) == path_components(found.data_loc)) {
+          found.links.emplace_back(path, target);
+        }
+        return 0;
+      },
+      &found));
+  return found.links;
+}
+
+struct mirror_children {
+  std::string source;
+  std::string path;
+  created_path const* created;
+  hid_t dest;
+};
+
+// recreates the soft links among the children of source_group in dest so they resolve inside dest, and
+// links every other child that is not created in dest to the same path in the source file
+void link_other_children(hid_t source_group, mirror_children& children) {
+  check_hdf5(H5Literate(
+      source_group, H5_INDEX_NAME, H5_ITER_NATIVE, nullptr,
+      [](hid_t group, const char* name, const H5L_info_t* info, void* data) -> herr_t {
+        auto& children = *static_cast<mirror_children*>(data);
+        if (children.created->children.count(name)) return 0;
+        if (info->type == H5L_TYPE_SOFT) {
+          std::string target(info->u.val_size, '\0');
+          if (H5Lget_val(group, name, target.data(), target.size(), H5P_DEFAULT) < 0) return -1;
+          return H5Lcreate_soft(target.c_str(), children.dest, name, H5P_DEFAULT, H5P_DEFAULT);
+        }
+        std::string target = children.path + "/" + name;
+        return H5Lcreate_external(children.source.c_str(), target.c_str(), children.dest, name, H5P_DEFAULT,
+                                  H5P_DEFAULT);
+      },
+      &children));
+}
+
+void create_data(hid_t source_group, hid_t dest_group, std::string const& name) {
+  auto source_data = open_dset(source_group, name.c_str());
+  hid_t type = check_hdf5(H5Dget_type(source_data.dset));
+  cleanup cleanup_type([=] { H5Tclose(type); });
+  hid_t dcpl = check_hdf5(H5Dget_create_plist(source_data.dset));
+  cleanup cleanup_dcpl([=] { H5Pclose(dcpl); });
+  // ranks write to the dataset independently later, which parallel HDF5 only permits without filters
+  if (H5Pget_nfilters(dcpl) > 0) {
+    check_hdf5(H5Premove_filter(dcpl, H5Z_FILTER_ALL));
+  }
+  // and only once the space is allocated, so allocate it now
+  check_hdf5(H5Pset_alloc_time(dcpl, H5D_ALLOC_TIME_EARLY));
+  hid_t dest_data =
+      check_hdf5(H5Dcreate(dest_group, name.c_str(), type, source_data.space, H5P_DEFAULT, dcpl, H5P_DEFAULT));
+  cleanup cleanup_dest_data([=] { H5Dclose(dest_data); });
+  copy_attributes(source_data.dset, dest_data);
+}
+
+void create_children(hid_t source_group, hid_t dest_group, mirror_children& children) {
+  link_other_children(source_group, children);
+  for (auto const& [name, created] : children.created->children) {
+    if (!created.soft_target.empty()) {
+      check_hdf5(H5Lcreate_soft(created.soft_target.c_str(), dest_group, name.c_str(), H5P_DEFAULT, H5P_DEFAULT));
+    } else if (created.children.empty()) {
+      create_data(source_group, dest_group, name);
+    } else {
+      hid_t next_source = check_hdf5(H5Gopen(source_group, name.c_str(), H5P_DEFAULT));
+      cleanup cleanup_next_source([=] { H5Gclose(next_source); });
+      hid_t next_dest = check_hdf5(H5Gcreate(dest_group, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+      cleanup cleanup_next_dest([=] { H5Gclose(next_dest); });
+      copy_attributes(next_source, next_dest);
+      mirror_children next{children.source, children.path + "/" + name, &created, next_dest};
+      create_children(next_source, next_dest, next);
+    }
+  }
+}
+}  // namespace
+
+void create_linked_file(std::string const& source, std::string const& dest, const char* data_loc) {
+  // external links resolve relative names against the working directory of the reader
+  std::array<char, PATH_MAX> resolved;
+  if (!realpath(source.c_str(), resolved.data())) {
+    throw std::runtime_error("failed to resolve " + source);
+  }
+  std::string const source_path = resolved.data();
+
+  auto const components = path_components(data_loc);
+  if (components.empty()) {
+    throw std::runtime_error("invalid dataset location "s + data_loc);
+  }
+
+  hid_t source_file = check_hdf5(H5Fopen(source.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT));
+  cleanup cleanup_source_file([=] { H5Fclose(source_file); });
+  hid_t dest_file = check_hdf5(H5Fcreate(dest.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT));
+  cleanup cleanup_dest_file([=] { H5Fclose(dest_file); });
+
+  // the dataset and every soft link to it are created in dest along with the groups that hold them, so
+  // that the links reach the new dataset rather than the source's
+  created_path root;
+  created_path* node = &root;
+  for (auto const& name : components) node = &node->children[name];
+  for (auto const& [path, target] : soft_links_to(source_file, data_loc)) {
+    node = &root;
+    for (auto const& name : path_components(path)) node = &node->children[name];
+    node->soft_target = target;
+  }
+
+  hid_t source_group = check_hdf5(H5Gopen(source_file, "/", H5P_DEFAULT));
+  cleanup cleanup_source_group([=] { H5Gclose(source_group); });
+  hid_t dest_group = check_hdf5(H5Gopen(dest_file, "/", H5P_DEFAULT));
+  cleanup cleanup_dest_group([=] { H5Gclose(dest_group); });
+  copy_attributes(source_group, dest_group);
+  mirror_children children{source_path, "", &root, dest_group};
+  create_children(source_group, dest_group, children);
 }
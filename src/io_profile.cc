@@ -0,0 +1,104 @@
+#include "io_profile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+#include "cleanup.h"
+#include "hdf5_helpers.h"
+
+namespace {
+std::string hint_value(nlohmann::json const& value) {
+  return value.is_string() ? value.get<std::string>() : value.dump();
+}
+
+H5FD_mpio_xfer_t parse_transfer(std::string const& mode) {
+  if (mode == "collective") return H5FD_MPIO_COLLECTIVE;
+  if (mode == "independent") return H5FD_MPIO_INDEPENDENT;
+  throw std::runtime_error("invalid transfer mode " + mode);
+}
+}  // namespace
+
+io_profile io_profile::load(std::string const& path) {
+  std::ifstream input(path);
+  if (!input) {
+    throw std::runtime_error("failed to open io profile " + path);
+  }
+  nlohmann::json j;
+  input >> j;
+
+  io_profile profile;
+  profile.json = j.dump();
+  profile.name = j.value("name", path);
+  if (j.contains("mpi_hints")) {
+    for (auto const& [key, value] : j.at("mpi_hints").items()) {
+      profile.mpi_hints[key] = hint_value(value);
+    }
+  }
+  if (j.contains("transfer")) {
+    for (auto const& [loc, mode] : j.at("transfer").items()) {
+      parse_transfer(mode.get<std::string>());
+      profile.transfer[loc] = mode.get<std::string>();
+    }
+  }
+  if (j.contains("alignment")) {
+    auto const& alignment = j.at("alignment");
+    profile.alignment_threshold = alignment.value("threshold", hsize_t{1});
+    profile.alignment = alignment.value("alignment", hsize_t{1});
+  }
+  profile.metadata_cache_bytes = j.value("metadata_cache_bytes", size_t{0});
+  if (j.contains("chunk_cache")) {
+    auto const& cache = j.at("chunk_cache");
+    profile.chunk_cache_bytes = cache.value("bytes", size_t{0});
+    profile.chunk_cache_slots = cache.value("slots", size_t{0});
+    profile.chunk_cache_w0 = cache.value("w0", 0.75);
+  }
+  return profile;
+}
+
+void io_profile::apply(hid_t fapl, MPI_Comm comm) const {
+  MPI_Info info = MPI_INFO_NULL;
+  if (!mpi_hints.empty()) {
+    MPI_Info_create(&info);
+    for (auto const& [key, value] : mpi_hints) {
+      MPI_Info_set(info, key.c_str(), value.c_str());
+    }
+  }
+  // HDF5 keeps its own copy of the info object
+  cleanup cleanup_info([&] {
+    if (info != MPI_INFO_NULL) MPI_Info_free(&info);
+  });
+  check_hdf5(H5Pset_fapl_mpio(fapl, comm, info));
+  apply_serial(fapl);
+}
+
+void io_profile::apply_serial(hid_t fapl) const {
+  if (alignment > 1) {
+    check_hdf5(H5Pset_alignment(fapl, alignment_threshold, alignment));
+  }
+  if (metadata_cache_bytes) {
+    H5AC_cache_config_t config;
+    config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+    check_hdf5(H5Pget_mdc_config(fapl, &config));
+    config.set_initial_size = true;
+    config.initial_size = metadata_cache_bytes;
+    config.min_size = std::min(config.min_size, metadata_cache_bytes);
+    config.max_size = std::max(config.max_size, metadata_cache_bytes);
+    check_hdf5(H5Pset_mdc_config(fapl, &config));
+  }
+  if (chunk_cache_bytes || chunk_cache_slots) {
+    int mdc_elements;
+    size_t slots, bytes;
+    double w0;
+    check_hdf5(H5Pget_cache(fapl, &mdc_elements, &slots, &bytes, &w0));
+    check_hdf5(H5Pset_cache(fapl, mdc_elements, chunk_cache_slots ? chunk_cache_slots : slots,
+                            chunk_cache_bytes ? chunk_cache_bytes : bytes, chunk_cache_w0));
+  }
+}
+
+H5FD_mpio_xfer_t io_profile::transfer_mode(std::string const& loc) const {
+  auto it = transfer.find(loc);
+  if (it == transfer.end()) it = transfer.find("default");
+  return it == transfer.end() ? H5FD_MPIO_COLLECTIVE : parse_transfer(it->second);
+}
@@ -0,0 +1,155 @@
+#include "memory_model.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+/** \returns the elements of a small integer or floating point option such as a shape */
+std::vector<size_t> to_sizes(pressio_data const& data) {
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < data.num_elements(); ++i) {
+    switch (data.dtype()) {
+      case pressio_double_dtype:
+        sizes.push_back(static_cast<double const*>(data.data())[i]);
+        break;
+      case pressio_float_dtype:
+        sizes.push_back(static_cast<float const*>(data.data())[i]);
+        break;
+      case pressio_int32_dtype:
+        sizes.push_back(static_cast<int32_t const*>(data.data())[i]);
+        break;
+      case pressio_uint32_dtype:
+        sizes.push_back(static_cast<uint32_t const*>(data.data())[i]);
+        break;
+      case pressio_int64_dtype:
+        sizes.push_back(static_cast<int64_t const*>(data.data())[i]);
+        break;
+      case pressio_uint64_dtype:
+        sizes.push_back(static_cast<uint64_t const*>(data.data())[i]);
+        break;
+      default:
+        return {};
+    }
+  }
+  return sizes;
+}
+
+/** \returns the number in the first line of path, or max if it cannot be read (or is "max") */
+size_t read_limit(const char* path) {
+  std::ifstream in(path);
+  std::string value;
+  if (!(in >> value) || value == "max") return std::numeric_limits<size_t>::max();
+  try {
+    return std::stoull(value);
+  } catch (std::exception const&) {
+    return std::numeric_limits<size_t>::max();
+  }
+}
+
+/**
+ * \returns the least room left under the memory limits of the cgroup at path below root and of every
+ * cgroup above it, since the limits of the ancestors apply too
+ */
+size_t cgroup_room(std::string const& root, std::string path, const char* limit_file, const char* usage_file) {
+  size_t room = std::numeric_limits<size_t>::max();
+  while (true) {
+    std::string const dir = root + path + "/";
+    size_t const limit = read_limit((dir + limit_file).c_str());
+    if (limit != std::numeric_limits<size_t>::max()) {
+      size_t usage = read_limit((dir + usage_file).c_str());
+      if (usage == std::numeric_limits<size_t>::max()) usage = 0;
+      room = std::min(room, limit > usage ? limit - usage : 0);
+    }
+    if (path.empty() || path == "/") break;
+    path.erase(path.find_last_of('/'));
+  }
+  return room;
+}
+}  // namespace
+
+void memory_model::set_options(pressio_options const& options) {
+  pressio_data shape;
+  if (options.get("binning:shape", &shape) == pressio_options_key_set) {
+    auto const sizes = to_sizes(shape);
+    if (!sizes.empty()) {
+      bin_elements = 1;
+      for (auto size : sizes) bin_elements *= std::max<size_t>(size, 1);
+    }
+  }
+  pressio_data roi_size;
+  if (options.get("roibin:roi_size", &roi_size) == pressio_options_key_set) {
+    auto const sizes = to_sizes(roi_size);
+    if (!sizes.empty()) {
+      // the ROI extends roi_size in both directions around each peak
+      roi_elements = 1;
+      for (auto size : sizes) roi_elements *= 2 * size + 1;
+    }
+  }
+}
+
+size_t memory_model::bytes_per_event() const {
+  double const frame = static_cast<double>(element_size) * frame_elements;
+  double const held = frame * frame_buffers;
+  double const working = frame * (1 + (decompress ? 1 : 0)) + 2 * background_factor * frame / bin_elements +
+                         (1 + roi_factor) * element_size * roi_elements * max_peaks + 7.0 * max_peaks * element_size;
+  return static_cast<size_t>(held + working * chunks_in_flight);
+}
+
+size_t memory_model::bytes_per_rank(size_t chunk_size, size_t ranks) const {
+  return chunk_size * bytes_per_event() + node_bytes / std::max<size_t>(ranks, 1);
+}
+
+size_t memory_model::chunk_size_for(size_t node_budget, size_t ranks) const {
+  ranks = std::max<size_t>(ranks, 1);
+  if (node_budget <= node_bytes) return 0;
+  return (node_budget - node_bytes) / ranks / std::max<size_t>(bytes_per_event(), 1);
+}
+
+size_t available_memory() {
+  size_t available = std::numeric_limits<size_t>::max();
+  std::ifstream meminfo("/proc/meminfo");
+  std::string key;
+  size_t value;
+  std::string unit;
+  while (meminfo >> key >> value >> unit) {
+    if (key == "MemAvailable:") {
+      available = value * 1024;
+      break;
+    }
+  }
+
+  // without a cgroup namespace, such as in Slurm or PBS jobs, the limits of this process are in its own
+  // cgroup: the "0::<path>" line for v2 and the line of the memory controller for v1
+  std::string v2_path = "/", v1_path = "/";
+  std::ifstream cgroups("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(cgroups, line)) {
+    auto const first = line.find(':');
+    auto const second = line.find(':', first + 1);
+    if (first == std::string::npos || second == std::string::npos) continue;
+    auto const controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+    auto const path = line.substr(second + 1);
+    if (controllers == ",,") {
+      v2_path = path;
+    } else if (controllers.find(",memory,") != std::string::npos) {
+      v1_path = path;
+    }
+  }
+  available = std::min(available, cgroup_room("/sys/fs/cgroup", v2_path, "memory.max", "memory.current"));
+  available = std::min(available, cgroup_room("/sys/fs/cgroup/memory", v1_path, "memory.limit_in_bytes",
+                                              "memory.usage_in_bytes"));
+  return available;
+}
+
+size_t peak_rss() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  // ru_maxrss is in kilobytes on Linux
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
@@ -1,16 +1,26 @@
+#include <hdf5.h>
 #include <mpi.h>
 #include <unistd.h>
 
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <thread>
+#include <vector>
 
+#include "cleanup.h"
+#include "hdf5_helpers.h"
 #include "roibin_test_version.h"
+#include "work_schedule.h"
 
 const std::string usage = R"(pressio_load
 code to test loading pressio_compressor from json
 
+-c <chunk_size> chunk_size
+-n <tasks> number of events to partition
+-f <cxi_filename> partition the events of this file by the predicted cost of their peaks
+-C <frame_cost>,<peak_cost> cost model used with -f (default: 1,0.005)
 -h print this message
 -v print the version information
 )";
@@ -18,6 +28,8 @@ code to test loading pressio_compressor from json
 struct cmdline_args {
   size_t tasks = 1;
   size_t chunk_size = 1;
+  std::string cxi_filename;
+  cost_model cost;
 };
 
 using namespace std::string_literals;
@@ -27,7 +39,7 @@ cmdline_args parse_args(int argc, char* argv[]) {
   cmdline_args args;
 
   int opt;
-  while ((opt = getopt(argc, argv, "c:hvn:")) != -1) {
+  while ((opt = getopt(argc, argv, "c:C:f:hvn:")) != -1) {
     switch (opt) {
       case 'c': {
         args.chunk_size = std::atoi(optarg);
@@ -43,6 +55,15 @@ cmdline_args parse_args(int argc, char* argv[]) {
           exit(1);
         }
       } break;
+      case 'f':
+        args.cxi_filename = optarg;
+        break;
+      case 'C':
+        if (sscanf(optarg, "%lf,%lf", &args.cost.frame_cost, &args.cost.peak_cost) != 2) {
+          std::cerr << "invalid cost model: " << optarg << std::endl;
+          exit(1);
+        }
+        break;
       case 'h':
         std::cout << usage << std::endl;
         ;
@@ -57,6 +78,41 @@ cmdline_args parse_args(int argc, char* argv[]) {
 
   return args;
 }
+std::vector<int64_t> read_npeaks(std::string const& cxi_filename) {
+  hid_t cxi = check_hdf5(H5Fopen(cxi_filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT));
+  cleanup cleanup_cxi([&] { H5Fclose(cxi); });
+  auto npeaks = open_dset(cxi, "/entry_1/result_1/nPeaks");
+  std::vector<int64_t> npeaks_data(npeaks.get_dims_hsize().front());
+  check_hdf5(H5Dread(npeaks.dset, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, npeaks_data.data()));
+  return npeaks_data;
+}
+
+void weighted_partition(cmdline_args const& args, int rank, int size) {
+  auto npeaks = read_npeaks(args.cxi_filename);
+  weighted_schedule schedule(npeaks, args.cost, args.chunk_size, MPI_COMM_WORLD);
+  std::cout << "rank=" << rank << " begin=" << schedule.begin() << " end=" << schedule.end()
+            << " predicted_cost=" << schedule.predicted_cost() << std::endl;
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  uint64_t total_work_items_per_rank = 0;
+  work_range range;
+  while (schedule.next(range)) {
+    total_work_items_per_rank += range.work_items;
+    std::cout << "rank=" << rank << " id=" << range.id << " work_items=" << range.work_items << std::endl;
+  }
+
+  double cost = schedule.predicted_cost(), max_cost = 0, total_cost = 0;
+  MPI_Reduce(&cost, &max_cost, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&cost, &total_cost, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  uint64_t total_work_items = 0;
+  MPI_Reduce(&total_work_items_per_rank, &total_work_items, 1, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (rank == 0) {
+    std::cout << "total_work_items=" << total_work_items << std::endl;
+    std::cout << "predicted_imbalance=" << (total_cost > 0 ? max_cost / (total_cost / size) : 1.0)
+              << std::endl;
+  }
+}
+
 int main(int argc, char* argv[]) {
   int rank, size;
   MPI_Init(&argc, &argv);
@@ -70,6 +126,17 @@ int main(int argc, char* argv[]) {
   }
   MPI_Barrier(MPI_COMM_WORLD);
 
+  if (!args.cxi_filename.empty()) {
+    try {
+      weighted_partition(args, rank, size);
+    } catch (std::exception const& ex) {
+      std::cerr << ex.what() << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Finalize();
+    return 0;
+  }
+
   uint64_t total_work_items_per_rank = 0;
   for (size_t i = 0; i < args.tasks; i += (args.chunk_size * size)) {
     size_t id = i + rank * args.chunk_size;
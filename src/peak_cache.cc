@@ -0,0 +1,96 @@
+#include "peak_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "debug_helpers.h"
+
+namespace {
+// rows per read when compacting, bounds the size of the hyperslab union
+constexpr size_t compact_block_rows = 1024;
+}  // namespace
+
+peak_cache::peak_cache(h5dset const& npeaks, h5dset const& posx, h5dset const& posy,
+                       MPI_Comm node_comm, bool compact)
+    : events(npeaks.get_dims_hsize().front()), peaks(posx.get_dims_hsize().back()) {
+  int node_rank;
+  MPI_Comm_rank(node_comm, &node_rank);
+
+  // the leader needs nPeaks up front to size a compacted window
+  std::vector<int64_t> npeaks_data;
+  uint64_t total_peaks = events * peaks;
+  if (node_rank == 0 && compact) {
+    npeaks_data.resize(events);
+    auto npeaks_view = pressio_data::nonowning(pressio_int64_dtype, npeaks_data.data(), {events});
+    read(npeaks, {0}, {events}, npeaks_view, events, false, H5FD_MPIO_INDEPENDENT);
+    loaded_bytes += events * sizeof(int64_t);
+    total_peaks = 0;
+    for (auto n : npeaks_data) total_peaks += std::max<int64_t>(n, 0);
+  }
+  MPI_Bcast(&total_peaks, 1, MPI_UINT64_T, 0, node_comm);
+
+  size_t const offsets_size = compact ? (events + 1) : 0;
+  bytes = events * sizeof(int64_t) + offsets_size * sizeof(uint64_t) + 2 * total_peaks * sizeof(double);
+  void* base = nullptr;
+  MPI_Win_allocate_shared((node_rank == 0) ? bytes : 0, 1, MPI_INFO_NULL, node_comm, &base, &win);
+  MPI_Aint leader_size;
+  int disp_unit;
+  MPI_Win_shared_query(win, 0, &leader_size, &disp_unit, &base);
+  npeaks_ptr = static_cast<int64_t*>(base);
+  if (compact) offsets_ptr = reinterpret_cast<uint64_t*>(npeaks_ptr + events);
+  posx_ptr = reinterpret_cast<double*>(npeaks_ptr + events + offsets_size);
+  posy_ptr = posx_ptr + total_peaks;
+
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+  if (node_rank == 0 && compact) {
+    std::copy(npeaks_data.begin(), npeaks_data.end(), npeaks_ptr);
+    offsets_ptr[0] = 0;
+    for (size_t e = 0; e < events; ++e) {
+      offsets_ptr[e + 1] = offsets_ptr[e] + std::max<int64_t>(npeaks_ptr[e], 0);
+    }
+    for (size_t first = 0; first < events; first += compact_block_rows) {
+      size_t const rows = std::min(compact_block_rows, events - first);
+      auto posx_data = positions(posx_ptr, first, rows);
+      auto posy_data = positions(posy_ptr, first, rows);
+      loaded_bytes += read_row_prefixes(posx, first, npeaks_ptr + first, rows, posx_data, H5FD_MPIO_INDEPENDENT);
+      loaded_bytes += read_row_prefixes(posy, first, npeaks_ptr + first, rows, posy_data, H5FD_MPIO_INDEPENDENT);
+    }
+    logger("loaded compact peak cache ", bytes, " bytes");
+  } else if (node_rank == 0) {
+    auto npeaks_data = pressio_data::nonowning(pressio_int64_dtype, npeaks_ptr, {events});
+    auto posx_data = pressio_data::nonowning(pressio_double_dtype, posx_ptr, {peaks, events});
+    auto posy_data = pressio_data::nonowning(pressio_double_dtype, posy_ptr, {peaks, events});
+    read(npeaks, {0}, {events}, npeaks_data, events, false, H5FD_MPIO_INDEPENDENT);
+    read(posx, {0, 0}, {events, peaks}, posx_data, events, false, H5FD_MPIO_INDEPENDENT);
+    read(posy, {0, 0}, {events, peaks}, posy_data, events, false, H5FD_MPIO_INDEPENDENT);
+    loaded_bytes += bytes;
+    logger("loaded peak cache ", bytes, " bytes");
+  }
+  // make the leader's stores visible to the rest of the node
+  MPI_Win_sync(win);
+  MPI_Barrier(node_comm);
+  MPI_Win_sync(win);
+}
+
+peak_cache::~peak_cache() {
+  MPI_Win_unlock_all(win);
+  MPI_Win_free(&win);
+}
+
+pressio_data peak_cache::npeaks(size_t id, size_t work_items) const {
+  return pressio_data::nonowning(pressio_int64_dtype, npeaks_ptr + id, {work_items});
+}
+pressio_data peak_cache::posx(size_t id, size_t work_items) const {
+  return positions(posx_ptr, id, work_items);
+}
+pressio_data peak_cache::posy(size_t id, size_t work_items) const {
+  return positions(posy_ptr, id, work_items);
+}
+
+pressio_data peak_cache::positions(double* base, size_t id, size_t work_items) const {
+  if (compacted()) {
+    return pressio_data::nonowning(pressio_double_dtype, base + offsets_ptr[id],
+                                   {offsets_ptr[id + work_items] - offsets_ptr[id]});
+  }
+  return pressio_data::nonowning(pressio_double_dtype, base + id * peaks, {peaks, work_items});
+}
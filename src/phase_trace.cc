@@ -0,0 +1,82 @@
+#include "phase_trace.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+void phase_trace::start(size_t capacity, MPI_Comm comm) {
+  events.assign(capacity, trace_event{});
+  next = 0;
+  // the steady clocks of different nodes are unrelated; start every rank's clock together instead
+  MPI_Barrier(comm);
+  origin = clock::now();
+}
+
+void phase_trace::record(char const* name, uint64_t chunk, clock::time_point begin, uint32_t thread) {
+  if (events.empty()) return;
+  auto const end = clock::now();
+  size_t const slot = next.fetch_add(1, std::memory_order_relaxed);
+  if (slot >= events.size()) return;
+  auto since_origin = [this](clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin).count();
+  };
+  events[slot] = trace_event{name, chunk, since_origin(begin), since_origin(end), thread};
+}
+
+size_t phase_trace::dropped() const {
+  size_t const recorded = next.load(std::memory_order_relaxed);
+  return recorded > events.size() ? recorded - events.size() : 0;
+}
+
+void phase_trace::dump(std::string const& path, MPI_Comm comm) const {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  // timestamps are in microseconds; keep three decimals for nanosecond resolution
+  std::string local;
+  char buffer[256];
+  snprintf(buffer, sizeof(buffer),
+           "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}", rank, rank);
+  local += buffer;
+  size_t const recorded = std::min(next.load(std::memory_order_relaxed), events.size());
+  for (size_t i = 0; i < recorded; ++i) {
+    auto const& event = events[i];
+    snprintf(buffer, sizeof(buffer),
+             ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%" PRIu32
+             ",\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"chunk\":%" PRIu64 "}}",
+             event.name, rank, event.thread, event.begin_ns * 1e-3, (event.end_ns - event.begin_ns) * 1e-3,
+             event.chunk);
+    local += buffer;
+  }
+
+  int const local_size = static_cast<int>(local.size());
+  std::vector<int> sizes(rank == 0 ? size : 0);
+  MPI_Gather(&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, comm);
+  std::vector<int> displs(sizes.size());
+  std::string all;
+  if (rank == 0) {
+    int total = 0;
+    for (int r = 0; r < size; ++r) {
+      displs[r] = total;
+      total += sizes[r];
+    }
+    all.resize(total);
+  }
+  MPI_Gatherv(local.data(), local_size, MPI_CHAR, all.data(), sizes.data(), displs.data(), MPI_CHAR, 0, comm);
+
+  if (rank == 0) {
+    std::ofstream out(path);
+    if (!out) {
+      throw std::runtime_error("failed to open trace file " + path);
+    }
+    out << "{\"traceEvents\":[\n";
+    for (int r = 0; r < size; ++r) {
+      if (r != 0) out << ",\n";
+      out.write(all.data() + displs[r], sizes[r]);
+    }
+    out << "\n]}\n";
+  }
+}
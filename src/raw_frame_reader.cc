@@ -0,0 +1,157 @@
+#include "raw_frame_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "file_helpers.h"
+
+namespace {
+// O_DIRECT transfers must be aligned to the logical block size of the device
+constexpr size_t direct_alignment = 4096;
+}  // namespace
+
+raw_frame_reader::mode raw_frame_reader::parse_mode(std::string const& name) {
+  if (name == "pread") return mode::pread;
+  if (name == "direct") return mode::direct;
+  if (name == "mmap") return mode::mmap;
+  throw std::runtime_error("invalid raw read mode " + name);
+}
+
+const char* raw_frame_reader::mode_name(mode how) {
+  switch (how) {
+    case mode::pread:
+      return "pread";
+    case mode::direct:
+      return "direct";
+    case mode::mmap:
+      return "mmap";
+  }
+  return "unknown";
+}
+
+std::unique_ptr<raw_frame_reader> raw_frame_reader::open(std::string const& path, h5dset const& dset, mode how) {
+  hid_t dcpl = check_hdf5(H5Dget_create_plist(dset.dset));
+  cleanup cleanup_dcpl([=] { H5Pclose(dcpl); });
+  if (H5Pget_layout(dcpl) != H5D_CONTIGUOUS || H5Pget_external_count(dcpl) != 0) return nullptr;
+  haddr_t const offset = H5Dget_offset(dset.dset);
+  if (offset == HADDR_UNDEF) return nullptr;
+
+  // the bytes are used as they are stored and the frames are processed as floats, so the stored type
+  // must be the native float type
+  auto const dtype = dset.get_pressio_dtype();
+  if (dtype != pressio_float_dtype) return nullptr;
+  hid_t stored_type = check_hdf5(H5Dget_type(dset.dset));
+  cleanup cleanup_stored_type([=] { H5Tclose(stored_type); });
+  if (H5Tequal(stored_type, pressio_to_hdf5_native_type(dtype)) <= 0) return nullptr;
+
+  std::unique_ptr<raw_frame_reader> reader(new raw_frame_reader);
+  reader->how = how;
+  reader->dtype = dtype;
+  reader->data_offset = offset;
+  auto dims = dset.get_pressio_dims();
+  reader->frames = dims.back();
+  dims.pop_back();
+  reader->frame_dims = dims;
+  reader->frame_bytes = pressio_dtype_size(dtype);
+  for (auto dim : dims) reader->frame_bytes *= dim;
+
+  reader->fd = ::open(path.c_str(), O_RDONLY | (how == mode::direct ? O_DIRECT : 0));
+  if (reader->fd < 0) {
+    throw posix_error("failed to open frames");
+  }
+  if (how == mode::mmap) {
+    long const page = sysconf(_SC_PAGESIZE);
+    reader->map_skew = offset % page;
+    reader->map_bytes = reader->map_skew + reader->frames * reader->frame_bytes;
+    reader->map = mmap(nullptr, reader->map_bytes, PROT_READ, MAP_SHARED, reader->fd, offset - reader->map_skew);
+    if (reader->map == MAP_FAILED) {
+      reader->map = nullptr;
+      throw posix_error("failed to map frames");
+    }
+    madvise(reader->map, reader->map_bytes, MADV_SEQUENTIAL);
+  }
+  return reader;
+}
+
+raw_frame_reader::~raw_frame_reader() {
+  if (map) munmap(map, map_bytes);
+  free(bounce);
+  if (fd >= 0) close(fd);
+}
+
+void raw_frame_reader::read_bytes(void* buffer, off_t offset, size_t bytes) {
+  auto* out = static_cast<char*>(buffer);
+  while (bytes > 0) {
+    auto got = pread(fd, out, bytes, offset);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      throw posix_error("failed to read frames");
+    } else if (got == 0) {
+      throw std::runtime_error("unexpected end of file reading frames");
+    }
+    out += got;
+    offset += got;
+    bytes -= got;
+  }
+}
+
+void raw_frame_reader::read(hsize_t first, size_t count, pressio_data& data) {
+  if (count == 0) return;
+  if (first + count > frames) {
+    throw std::runtime_error("raw read past the end of the frames");
+  }
+  off_t const offset = data_offset + first * frame_bytes;
+  size_t const bytes = count * frame_bytes;
+  if (how != mode::mmap && data.dtype() != dtype) {
+    throw std::runtime_error("raw read buffer does not have the type of the frames");
+  }
+
+  switch (how) {
+    case mode::pread:
+      if (data.size_in_bytes() < bytes) {
+        throw std::runtime_error("raw read buffer is smaller than the frames");
+      }
+      read_bytes(data.data(), offset, bytes);
+      break;
+    case mode::direct: {
+      if (data.size_in_bytes() < bytes) {
+        throw std::runtime_error("raw read buffer is smaller than the frames");
+      }
+      off_t const aligned_offset = offset / direct_alignment * direct_alignment;
+      size_t const skew = offset - aligned_offset;
+      // the file may end before the aligned end of the last frame, so short reads there are expected
+      size_t const aligned_bytes = (skew + bytes + direct_alignment - 1) / direct_alignment * direct_alignment;
+      if (aligned_bytes > bounce_bytes) {
+        free(bounce);
+        bounce = aligned_alloc(direct_alignment, aligned_bytes);
+        if (!bounce) throw std::bad_alloc();
+        bounce_bytes = aligned_bytes;
+      }
+      size_t done = 0;
+      while (done < skew + bytes) {
+        auto got = pread(fd, static_cast<char*>(bounce) + done, aligned_bytes - done, aligned_offset + done);
+        if (got < 0) {
+          if (errno == EINTR) continue;
+          throw posix_error("failed to read frames");
+        } else if (got == 0) {
+          throw std::runtime_error("unexpected end of file reading frames");
+        }
+        done += got;
+      }
+      std::memcpy(data.data(), static_cast<char*>(bounce) + skew, bytes);
+      break;
+    }
+    case mode::mmap: {
+      auto dims = frame_dims;
+      dims.push_back(count);
+      data = pressio_data::nonowning(dtype, static_cast<char*>(map) + map_skew + first * frame_bytes, dims);
+      break;
+    }
+  }
+}
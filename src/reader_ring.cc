@@ -0,0 +1,160 @@
+#include "reader_ring.h"
+
+#include <chrono>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr size_t cache_line = 64;
+// page aligned so readers can use O_DIRECT and the frames of a slot do not share pages with other slots
+constexpr size_t payload_alignment = 4096;
+
+size_t align(size_t offset, size_t alignment) { return (offset + alignment - 1) / alignment * alignment; }
+}  // namespace
+
+reader_ring::reader_ring(shape const& requested, size_t workers, MPI_Comm node_comm)
+    : ring(requested), workers(workers) {
+  int node_rank, node_size;
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &node_size);
+  rank = node_rank;
+  readers = node_size - workers;
+  MPI_Bcast(&ring, sizeof(ring), MPI_BYTE, 0, node_comm);
+  if (!enabled()) return;
+  if (readers == 0) {
+    throw std::runtime_error("reader_ring requires at least one reader rank per node");
+  }
+
+  npeaks_offset = 0;
+  posx_offset = align(npeaks_offset + ring.chunk_size * sizeof(int64_t), cache_line);
+  posy_offset = align(posx_offset + ring.chunk_size * ring.max_peaks * sizeof(double), cache_line);
+  frames_offset = align(posy_offset + ring.chunk_size * ring.max_peaks * sizeof(double), payload_alignment);
+  slot_bytes = align(frames_offset + ring.chunk_size * ring.frame_elements * sizeof(float), payload_alignment);
+  // the headers of every slot come first, then the finished flag of each worker, then the payloads
+  size_t const control_bytes =
+      align(workers * ring.slots * sizeof(slot_header) + workers * cache_line, payload_alignment);
+  bytes = control_bytes + workers * ring.slots * slot_bytes;
+
+  void* shared = nullptr;
+  // over-allocate so the payloads can be page aligned whatever alignment MPI gives the window
+  MPI_Win_allocate_shared((node_rank == 0) ? bytes + payload_alignment : 0, 1, MPI_INFO_NULL, node_comm, &shared,
+                          &win);
+  MPI_Aint leader_size;
+  int disp_unit;
+  MPI_Win_shared_query(win, 0, &leader_size, &disp_unit, &shared);
+  auto const address = reinterpret_cast<uintptr_t>(shared);
+  base = reinterpret_cast<char*>(align(address, payload_alignment));
+
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+  if (node_rank == 0) {
+    for (size_t worker = 0; worker < workers; ++worker) {
+      for (size_t slot = 0; slot < ring.slots; ++slot) {
+        auto* h = new (&header(worker, slot)) slot_header;
+        h->state.store(slot_free, std::memory_order_relaxed);
+      }
+      new (&finished(worker)) std::atomic<uint32_t>(0);
+    }
+  }
+  MPI_Win_sync(win);
+  MPI_Barrier(node_comm);
+  MPI_Win_sync(win);
+  payload = base + control_bytes;
+}
+
+reader_ring::~reader_ring() {
+  if (win == MPI_WIN_NULL) return;
+  MPI_Win_unlock_all(win);
+  MPI_Win_free(&win);
+}
+
+reader_ring::slot_header& reader_ring::header(size_t worker, size_t slot) const {
+  return reinterpret_cast<slot_header*>(base)[worker * ring.slots + slot];
+}
+
+std::atomic<uint32_t>& reader_ring::finished(size_t worker) const {
+  auto* flags = base + workers * ring.slots * sizeof(slot_header);
+  return *reinterpret_cast<std::atomic<uint32_t>*>(flags + worker * cache_line);
+}
+
+ring_slot reader_ring::view(size_t worker, size_t slot) const {
+  auto* start = payload + (worker * ring.slots + slot) * slot_bytes;
+  auto const& h = header(worker, slot);
+  ring_slot view;
+  view.id = h.id;
+  view.work_items = h.work_items;
+  view.npeaks = reinterpret_cast<int64_t*>(start + npeaks_offset);
+  view.posx = reinterpret_cast<double*>(start + posx_offset);
+  view.posy = reinterpret_cast<double*>(start + posy_offset);
+  view.frames = reinterpret_cast<float*>(start + frames_offset);
+  return view;
+}
+
+bool reader_ring::request(work_range const& range) {
+  if (range.work_items > ring.chunk_size) {
+    throw std::runtime_error("requested more events than a ring slot holds");
+  }
+  auto& h = header(rank, requested_count % ring.slots);
+  if (h.state.load(std::memory_order_acquire) != slot_free) return false;
+  h.id = range.id;
+  h.work_items = range.work_items;
+  h.state.store(slot_requested, std::memory_order_release);
+  ++requested_count;
+  return true;
+}
+
+ring_slot reader_ring::acquire() {
+  if (acquired_count == requested_count) {
+    throw std::logic_error("acquired a slot that was not requested");
+  }
+  size_t const slot = acquired_count++ % ring.slots;
+  auto& h = header(rank, slot);
+  if (h.state.load(std::memory_order_acquire) != slot_ready) {
+    auto const begin = std::chrono::steady_clock::now();
+    while (h.state.load(std::memory_order_acquire) != slot_ready) {
+      std::this_thread::yield();
+    }
+    waited += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  }
+  return view(rank, slot);
+}
+
+void reader_ring::release() {
+  if (released_count == acquired_count) {
+    throw std::logic_error("released a slot that was not acquired");
+  }
+  header(rank, released_count++ % ring.slots).state.store(slot_free, std::memory_order_release);
+}
+
+void reader_ring::finish() { finished(rank).store(1, std::memory_order_release); }
+
+void reader_ring::serve(std::function<void(ring_slot&)> const& read) {
+  // reader r serves workers r, r+readers, ...; each worker's slots are filled in the order requested
+  size_t const reader = rank - workers;
+  std::vector<size_t> next_slot(workers, 0);
+  std::vector<bool> done(workers, false);
+  size_t remaining = 0;
+  for (size_t worker = reader; worker < workers; worker += readers) ++remaining;
+
+  while (remaining) {
+    bool progress = false;
+    for (size_t worker = reader; worker < workers; worker += readers) {
+      if (done[worker]) continue;
+      // read the flag first so that every request posted before it is visible below
+      bool const worker_finished = finished(worker).load(std::memory_order_acquire);
+      auto& h = header(worker, next_slot[worker]);
+      if (h.state.load(std::memory_order_acquire) == slot_requested) {
+        auto slot = view(worker, next_slot[worker]);
+        read(slot);
+        h.state.store(slot_ready, std::memory_order_release);
+        next_slot[worker] = (next_slot[worker] + 1) % ring.slots;
+        progress = true;
+      } else if (worker_finished) {
+        done[worker] = true;
+        --remaining;
+      }
+    }
+    if (!progress) std::this_thread::yield();
+  }
+}
@@ -0,0 +1,164 @@
+#include "roibin_h5filter.h"
+
+#include <libpressio_ext/cpp/json.h>
+#include <libpressio_ext/cpp/pressio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// building a compressor from its json is much slower than decompressing a frame, so keep one per
+// configuration; HDF5 may call the filter from several threads
+std::mutex compressors_mutex;
+std::map<std::string, pressio_compressor> compressors;
+
+pressio_compressor& compressor_for(std::string const& config) {
+  static pressio library;
+  auto it = compressors.find(config);
+  if (it == compressors.end()) {
+    pressio_compressor comp = library.get_compressor("pressio");
+    if (!comp) {
+      throw std::runtime_error("failed to load the pressio compressor");
+    }
+    comp->set_name("pressio");
+    if (comp->set_options(static_cast<pressio_options>(nlohmann::json::parse(config)))) {
+      throw std::runtime_error(comp->error_msg());
+    }
+    it = compressors.emplace(config, std::move(comp)).first;
+  }
+  return it->second;
+}
+
+std::string config_from(size_t cd_nelmts, const unsigned int cd_values[]) {
+  if (cd_nelmts < 1 || (cd_nelmts - 1) * sizeof(unsigned int) < cd_values[0]) {
+    throw std::runtime_error("the roibin filter is missing the compressor configuration");
+  }
+  std::string config(cd_values[0], '\0');
+  std::memcpy(config.data(), cd_values + 1, config.size());
+  return config;
+}
+
+size_t decode(std::string const& config, size_t nbytes, size_t* buf_size, void** buf) {
+  auto const* chunk = static_cast<uint8_t const*>(*buf);
+  roibin_chunk_header header;
+  if (nbytes < sizeof(header)) {
+    throw std::runtime_error("roibin chunk is smaller than its header");
+  }
+  std::memcpy(&header, chunk, sizeof(header));
+  if (std::memcmp(header.magic, roibin_chunk_header{}.magic, sizeof(header.magic)) != 0 ||
+      header.version != roibin_chunk_header{}.version) {
+    throw std::runtime_error("not a roibin chunk");
+  }
+  size_t const centers_bytes = 3 * header.centers * sizeof(uint64_t);
+  if (nbytes < sizeof(header) + centers_bytes + header.stream_length) {
+    throw std::runtime_error("roibin chunk is truncated");
+  }
+  auto const* centers = chunk + sizeof(header);
+  auto const* stream = centers + centers_bytes;
+
+  std::vector<size_t> dims(std::begin(header.dims), std::end(header.dims));
+  auto const dtype = static_cast<pressio_dtype>(header.dtype);
+  size_t const output_bytes =
+      std::accumulate(dims.begin(), dims.end(), size_t{1}, std::multiplies<>{}) * pressio_dtype_size(dtype);
+  void* output = H5allocate_memory(output_bytes, false);
+  if (!output) {
+    throw std::runtime_error("failed to allocate the decompressed chunk");
+  }
+
+  try {
+    std::lock_guard lock(compressors_mutex);
+    auto& comp = compressor_for(config);
+    comp->set_options({{"roibin:centers",
+                        pressio_data::nonowning(pressio_uint64_dtype, const_cast<uint8_t*>(centers),
+                                                {3, static_cast<size_t>(header.centers)})}});
+    auto input = pressio_data::nonowning(pressio_byte_dtype, const_cast<uint8_t*>(stream),
+                                         {static_cast<size_t>(header.stream_length)});
+    auto decompressed = pressio_data::nonowning(dtype, output, dims);
+    if (comp->decompress(&input, &decompressed)) {
+      throw std::runtime_error(comp->error_msg());
+    }
+    // compressors that allocate their own output replace the view
+    if (decompressed.data() != output) {
+      std::memcpy(output, decompressed.data(), std::min(output_bytes, decompressed.size_in_bytes()));
+    }
+  } catch (...) {
+    H5free_memory(output);
+    throw;
+  }
+
+  H5free_memory(*buf);
+  *buf = output;
+  *buf_size = output_bytes;
+  return output_bytes;
+}
+
+size_t roibin_filter(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes,
+                     size_t* buf_size, void** buf) {
+  if (!(flags & H5Z_FLAG_REVERSE)) {
+    // the centers are not available to the filter, so chunks must be written with H5Dwrite_chunk
+    return 0;
+  }
+  try {
+    return decode(config_from(cd_nelmts, cd_values), nbytes, buf_size, buf);
+  } catch (std::exception const&) {
+    return 0;
+  }
+}
+
+}  // namespace
+
+const H5Z_class2_t roibin_h5filter_class[1] = {{
+    H5Z_CLASS_T_VERS,
+    roibin_h5filter_id,
+    // HDF5 refuses to create datasets with a mandatory filter that cannot encode
+    /*encoder_present*/ 1,
+    /*decoder_present*/ 1,
+    "roibin pressio filter",
+    /*can_apply*/ nullptr,
+    /*set_local*/ nullptr,
+    roibin_filter,
+}};
+
+void roibin_h5filter_register() {
+  // the plugin is built without the helpers, so this does not use check_hdf5
+  if (H5Zfilter_avail(roibin_h5filter_id) <= 0 && H5Zregister(roibin_h5filter_class) < 0) {
+    throw std::runtime_error("failed to register the roibin filter");
+  }
+}
+
+std::vector<unsigned int> roibin_h5filter_cd_values(std::string const& config) {
+  std::vector<unsigned int> cd_values(1 + (config.size() + sizeof(unsigned int) - 1) / sizeof(unsigned int), 0);
+  cd_values[0] = static_cast<unsigned int>(config.size());
+  std::memcpy(cd_values.data() + 1, config.data(), config.size());
+  return cd_values;
+}
+
+pressio_data roibin_h5filter_encode(std::vector<uint64_t> const& centers, std::vector<size_t> const& dims,
+                                    pressio_dtype dtype, pressio_data const& stream) {
+  if (dims.size() > 3) {
+    throw std::runtime_error("roibin chunks have at most 3 dimensions");
+  }
+  roibin_chunk_header header;
+  header.dtype = dtype;
+  header.centers = centers.size() / 3;
+  for (size_t i = 0; i < 3; ++i) {
+    header.dims[i] = i < dims.size() ? dims[i] : 1;
+  }
+  header.stream_length = stream.size_in_bytes();
+
+  size_t const centers_bytes = 3 * header.centers * sizeof(uint64_t);
+  auto chunk = pressio_data::owning(pressio_byte_dtype, {sizeof(header) + centers_bytes + stream.size_in_bytes()});
+  auto* out = static_cast<uint8_t*>(chunk.data());
+  std::memcpy(out, &header, sizeof(header));
+  out += sizeof(header);
+  if (centers_bytes) std::memcpy(out, centers.data(), centers_bytes);
+  out += centers_bytes;
+  if (header.stream_length) std::memcpy(out, stream.data(), header.stream_length);
+  return chunk;
+}
@@ -0,0 +1,9 @@
+#include <H5PLextern.h>
+
+#include "roibin_h5filter.h"
+
+// entry points HDF5 looks up when loading the filter from HDF5_PLUGIN_PATH
+
+extern "C" H5PL_type_t H5PLget_plugin_type(void) { return H5PL_TYPE_FILTER; }
+
+extern "C" const void* H5PLget_plugin_info(void) { return roibin_h5filter_class; }
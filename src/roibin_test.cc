@@ -5,18 +5,45 @@
 #include <mpi.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <future>
+#include <memory>
+#include <numeric>
 #include <iostream>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "buffer_pool.h"
+#include "centers_builder.h"
+#include "compressed_archive.h"
 #include "cleanup.h"
 #include "file_helpers.h"
+#include "flush_policy.h"
 #include "hdf5_helpers.h"
+#include "io_profile.h"
+#include "memory_model.h"
 #include "debug_helpers.h"
+#include "event_chunk_writer.h"
+#include "peak_cache.h"
+#include "phase_trace.h"
+#include "raw_frame_reader.h"
+#include "reader_ring.h"
+#include "roibin_h5filter.h"
+#include "roibin_test.h"
 #include "roibin_test_version.h"
+#include "thread_pool.h"
+#include "work_schedule.h"
+#include "write_aggregator.h"
 
 std::string basename(std::string const& base) {
   auto last_slash = base.rfind('/');
@@ -36,13 +63,41 @@ std::string basename(std::string const& base) {
 // clang-format off
 const std::string usage = R"(roibin_test experimental code to test roibin_sz3
 
--c <chunk_size> chunk_size
+-c <chunk_size> chunk_size, or auto for the largest chunk size whose predicted memory fits the available memory of each node
 -d debug output compression metric debug files
 -D <debug_dir> set the output directory for compression metric debug json files (defaults: $TMPDIR, /tmp)
 -f <cxi_filename> filename
 -p <presiso> config file
 -n <workers> workers_per_node
 -o <output_file> path to output the compressed and decompresed cxi, enables decompression stage
+-x <strategy> how -o copies the cxi file: auto (default; reflink if possible, otherwise every rank copies part of the
+   file with copy_file_range), reflink, copy_file_range, or sendfile
+-T <threads> threads each rank uses to copy its part of the cxi file (default: 1)
+-G <aggregators>[,<MiB>] with -o, send the decompressed chunks to aggregator ranks that write contiguous events in large
+   independent writes: node (the first worker of each node) or a number of ranks per job; each stages up to MiB (default: 256)
+-L with -o, write only the decompressed data to output_file and reach every other object of the cxi file through external links
+-s <schedule> how events are assigned to ranks: static (default), dynamic (ranks pull chunks from a shared counter; uses independent I/O),
+   weighted (contiguous ranges balanced by the predicted cost of their peaks, see -C), or adaptive (like dynamic, but each
+   rank starts with one HDF5 chunk of events and doubles or halves its chunk size from its measured GB/s, up to -c)
+-C <frame_cost>,<peak_cost> cost model for -s weighted: cost of an event is frame_cost + peak_cost * nPeaks (default: 1,0.005)
+-m load the peak tables once per node into shared memory instead of reading them for every chunk
+-S read only the first nPeaks columns of the peak tables for each event rather than all maxPeaks columns
+-j <threads> compression threads per rank, each with its own clone of the compressor; the events of every chunk are split
+   between them and compressed concurrently while only the rank's main thread does I/O (default: 1)
+-P <depth> pipeline depth; overlap reading/writing chunks with compression of up to depth chunks (default: 1, serial)
+-A <archive_file> write the compressed streams and a per-chunk index to a new HDF5 archive
+-E <filtered_file> also compress every event on its own and write them to filtered_file as chunks of the roibin HDF5 filter
+-R <repeats> keep the compressed chunks in memory and afterwards time decompressing all of them repeats times, without I/O
+-K read chunked, unfiltered frames with hyperslab reads rather than H5Dread_chunk direct chunk reads
+-r <mode> read contiguous frames from the cxi file without HDF5: pread, direct (pread with O_DIRECT), or mmap;
+   frames that are not stored contiguously as native floats are read with HDF5
+-N <slots> the ranks beyond -n on each node become reader ranks that read chunks ahead for the workers on their node
+   into a shared memory ring of slots chunks per worker (at least -P); the workers compress them in place
+-I <io_profile> json file of MPI-IO hints, per dataset transfer modes, and HDF5 alignment and cache sizes
+-F <policy> when to flush the output file: always (default, after every chunk), close, chunks:<N>, seconds:<T>,
+   or signal (after the next chunk once a rank receives SIGUSR1); only lockstep schedules flush before closing
+-t <trace_file> write the begin/end of each phase of each chunk on each rank to trace_file as Chrome trace-event JSON
+-H back the frame, compressed and decompressed buffers with transparent huge pages
 -h print this message
 -v print the version information
 -w <write_events> number of events to write (defaults: 0 if output_file is not set, otherwise num_events)
@@ -54,9 +109,30 @@ struct cmdline_args {
   std::string pressio_config_file = "share/blosc.json";
   std::string debug_dir = (getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp/");
   std::string output_file;
+  std::string trace_file;
+  std::string archive_file;
+  std::string filtered_file;
   size_t chunk_size = 1;
   size_t write_events = std::numeric_limits<size_t>::max();
+  std::string schedule = "static";
+  std::string aggregators;
+  size_t aggregator_buffer_mib = 256;
+  cost_model cost;
+  flush_policy flush = flush_policy::parse("always");
+  io_profile io;
+  std::optional<raw_frame_reader::mode> raw_reads;
+  size_t pipeline_depth = 1;
+  size_t compress_threads = 1;
+  size_t decompress_repeats = 0;
+  size_t reader_slots = 0;
+  copy_strategy copy = copy_strategy::automatic;
+  unsigned copy_threads = 1;
   int32_t workers_per_node = 0;
+  bool peak_cache = false;
+  bool sparse_peaks = false;
+  bool huge_pages = false;
+  bool link_output = false;
+  bool direct_chunks = true;
   bool debug = false;
   bool debug_buffers = false;
 };
@@ -67,23 +143,74 @@ cmdline_args parse_args(int argc, char* argv[]) {
   cmdline_args args;
 
   int opt;
-  while ((opt = getopt(argc, argv, "bc:dD:hvf:o:p:n:")) != -1) {
+  while ((opt = getopt(argc, argv, "A:bc:C:dD:E:F:G:hHI:j:Kvf:LmN:o:p:n:P:r:R:s:St:T:x:")) != -1) {
     switch (opt) {
       case 'c':
-        args.chunk_size = atoi(optarg);
-        if (args.chunk_size == 0) {
+        // a chunk_size of 0 selects the chunk size from the memory model
+        args.chunk_size = optarg == "auto"s ? 0 : atoi(optarg);
+        if (args.chunk_size == 0 && optarg != "auto"s) {
           throw std::runtime_error("invalid chunk_size"s + optarg);
         }
         break;
+      case 'C':
+        if (sscanf(optarg, "%lf,%lf", &args.cost.frame_cost, &args.cost.peak_cost) != 2) {
+          throw std::runtime_error("invalid cost model "s + optarg);
+        }
+        break;
       case 'b':
         args.debug_buffers = true;
         break;
+      case 'S':
+        args.sparse_peaks = true;
+        break;
+      case 'H':
+        args.huge_pages = true;
+        break;
+      case 'L':
+        args.link_output = true;
+        break;
+      case 'K':
+        args.direct_chunks = false;
+        break;
+      case 'r':
+        args.raw_reads = raw_frame_reader::parse_mode(optarg);
+        break;
+      case 'G': {
+        std::string const spec = optarg;
+        auto const comma = spec.find(',');
+        args.aggregators = spec.substr(0, comma);
+        if (comma != std::string::npos) {
+          args.aggregator_buffer_mib = atoi(spec.c_str() + comma + 1);
+        }
+        if (args.aggregators != "node" && atoi(args.aggregators.c_str()) < 1) {
+          throw std::runtime_error("invalid aggregators "s + optarg);
+        }
+        break;
+      }
+      case 'x':
+        args.copy = parse_copy_strategy(optarg);
+        break;
+      case 'T':
+        args.copy_threads = atoi(optarg);
+        if (args.copy_threads == 0) {
+          throw std::runtime_error("invalid copy threads"s + optarg);
+        }
+        break;
+      case 'm':
+        args.peak_cache = true;
+        break;
       case 'd':
         args.debug = true;
         break;
       case 'D':
         args.debug_dir = optarg;
         break;
+      case 'F':
+        args.flush = flush_policy::parse(optarg);
+        break;
+      case 'I':
+        args.io = io_profile::load(optarg);
+        break;
       case 'f':
         args.cxi_filename = optarg;
         break;
@@ -97,6 +224,46 @@ cmdline_args parse_args(int argc, char* argv[]) {
       case 'o':
         args.output_file = optarg;
         break;
+      case 't':
+        args.trace_file = optarg;
+        break;
+      case 'A':
+        args.archive_file = optarg;
+        break;
+      case 'E':
+        args.filtered_file = optarg;
+        break;
+      case 's':
+        args.schedule = optarg;
+        if (args.schedule != "static" && args.schedule != "dynamic" && args.schedule != "weighted" &&
+            args.schedule != "adaptive") {
+          throw std::runtime_error("invalid schedule "s + optarg);
+        }
+        break;
+      case 'j':
+        args.compress_threads = atoi(optarg);
+        if (args.compress_threads == 0) {
+          throw std::runtime_error("invalid compression threads"s + optarg);
+        }
+        break;
+      case 'P':
+        args.pipeline_depth = atoi(optarg);
+        if (args.pipeline_depth == 0) {
+          throw std::runtime_error("invalid pipeline depth"s + optarg);
+        }
+        break;
+      case 'N':
+        args.reader_slots = atoi(optarg);
+        if (args.reader_slots == 0) {
+          throw std::runtime_error("invalid reader slots"s + optarg);
+        }
+        break;
+      case 'R':
+        args.decompress_repeats = atoi(optarg);
+        if (args.decompress_repeats == 0) {
+          throw std::runtime_error("invalid decompress repeats"s + optarg);
+        }
+        break;
       case 'w':
         args.write_events = atoi(optarg);
         break;
@@ -127,9 +294,45 @@ cmdline_args parse_args(int argc, char* argv[]) {
   return args;
 }
 
+/**
+ * decompresses every kept chunk repeats times
+ *
+ * \returns the time in ms of each repetition on this rank; the ranks start each repetition together
+ */
+std::vector<double> time_decompress(pressio_compressor& comp, std::vector<kept_chunk> const& kept,
+                                    size_t repeats, MPI_Comm comm) {
+  size_t largest = 0;
+  for (auto const& chunk : kept) {
+    largest = std::max(largest, std::accumulate(chunk.dims.begin(), chunk.dims.end(), pressio_dtype_size(chunk.dtype),
+                                                std::multiplies<>{}));
+  }
+  auto output_buffer = pressio_data::owning(pressio_byte_dtype, {largest});
+
+  std::vector<double> repeat_ms;
+  repeat_ms.reserve(repeats);
+  for (size_t repeat = 0; repeat < repeats; ++repeat) {
+    MPI_Barrier(comm);
+    auto begin = std::chrono::steady_clock::now();
+    for (auto const& chunk : kept) {
+      comp->set_options({{"roibin:centers", pressio_data::nonowning(pressio_uint64_dtype, chunk.centers.data(),
+                                                                     chunk.centers.dimensions())}});
+      auto input = pressio_data::nonowning(pressio_byte_dtype, chunk.compressed.data(), chunk.compressed.dimensions());
+      auto output = pressio_data::nonowning(chunk.dtype, output_buffer.data(), chunk.dims);
+      if (comp->decompress(&input, &output)) {
+        throw std::runtime_error(comp->error_msg());
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    repeat_ms.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+  }
+  return repeat_ms;
+}
+
 int main(int argc, char* argv[]) {
   int world_rank, world_size, per_node_rank;
-  MPI_Init(&argc, &argv);
+  int thread_support;
+  // the pipeline thread never calls MPI, so funneled support is sufficient
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
   inital_time = MPI_Wtime();
   cleanup cleanup_init([&] { MPI_Finalize(); });
 
@@ -137,6 +340,10 @@ int main(int argc, char* argv[]) {
 
   MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
   MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  if (args.pipeline_depth > 1 && thread_support < MPI_THREAD_FUNNELED) {
+    if (world_rank == 0) logger("MPI does not support MPI_THREAD_FUNNELED, disabling pipelining");
+    args.pipeline_depth = 1;
+  }
 
   // create communicators of ranks within each node
   MPI_Comm per_node_comm;
@@ -156,24 +363,92 @@ int main(int argc, char* argv[]) {
   MPI_Comm_rank(work_comm, &work_rank);
   MPI_Comm_size(work_comm, &work_size);
 
+  // create communicators of the worker ranks within each node
+  MPI_Comm node_work_comm;
+  MPI_Comm_split(per_node_comm, (per_node_rank < args.workers_per_node) ? 0 : MPI_UNDEFINED, per_node_rank,
+                 &node_work_comm);
+  cleanup cleanup_node_work_comm([&] {
+    if (node_work_comm != MPI_COMM_NULL) MPI_Comm_free(&node_work_comm);
+  });
+
   std::string write_path = args.output_file;
-  if (!args.output_file.empty() && world_rank == 0) {
-    try {
-      std::cout << "started copy " << args.cxi_filename << " to " << write_path << std::endl;
-      copy_file(args.cxi_filename, write_path);
+  if (!args.output_file.empty() && args.link_output) {
+    if (world_rank == 0) {
+      try {
+        create_linked_file(args.cxi_filename, write_path, "/entry_1/data_1/data");
+        std::cout << "linked " << args.cxi_filename << " to " << write_path << std::endl;
+      } catch (std::exception const& ex) {
+        logger(ex.what());
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    }
+  } else if (!args.output_file.empty()) {
+    // rank 0 tries to reflink the file; otherwise every rank copies a contiguous part of it
+    auto const begin_copy = std::chrono::steady_clock::now();
+    std::array<uint64_t, 2> copy_plan{0, 0};  // reflinked, size
+    if (world_rank == 0) {
+      try {
+        std::cout << "started copy " << args.cxi_filename << " to " << write_path << std::endl;
+        copy_plan[1] = file_size(args.cxi_filename);
+        if (args.copy == copy_strategy::automatic || args.copy == copy_strategy::reflink) {
+          copy_plan[0] = reflink_file(args.cxi_filename, write_path);
+          if (!copy_plan[0] && args.copy == copy_strategy::reflink) {
+            throw std::runtime_error("the filesystem does not support reflinks");
+          }
+        }
+        if (!copy_plan[0]) create_file(write_path, copy_plan[1]);
+      } catch (std::exception const& ex) {
+        logger(ex.what());
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    }
+    MPI_Bcast(copy_plan.data(), copy_plan.size(), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    int used_sendfile = 0;
+    if (!copy_plan[0]) {
+      constexpr uint64_t alignment = 1 << 20;
+      uint64_t const size = copy_plan[1];
+      uint64_t const per_rank = (size / world_size + alignment - 1) / alignment * alignment;
+      uint64_t const offset = std::min(size, world_rank * per_rank);
+      try {
+        auto const stats = copy_file_part(
+            args.cxi_filename, write_path, offset, std::min(size - offset, per_rank),
+            args.copy == copy_strategy::sendfile ? copy_strategy::sendfile : copy_strategy::copy_file_range,
+            args.copy_threads);
+        used_sendfile = stats.strategy == copy_strategy::sendfile;
+      } catch (std::exception const& ex) {
+        logger(ex.what());
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    }
+    int any_sendfile = 0;
+    MPI_Reduce(&used_sendfile, &any_sendfile, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (world_rank == 0) {
+      double const copy_seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_copy).count();
+      auto const used = copy_plan[0] ? copy_strategy::reflink
+                        : any_sendfile ? copy_strategy::sendfile
+                                       : copy_strategy::copy_file_range;
       std::cout << "copied " << args.cxi_filename << " to " << write_path << std::endl;
-    } catch (std::exception const& ex) {
-      logger(ex.what());
-      MPI_Abort(MPI_COMM_WORLD, 1);
+      std::cout << "copy_strategy=" << copy_strategy_name(used) << std::endl;
+      std::cout << "copy_seconds=" << copy_seconds << std::endl;
+      std::cout << "copy_bandwidth_GBps=" << copy_plan[1] / copy_seconds * 1e-9 << std::endl;
     }
   }
   MPI_Barrier(MPI_COMM_WORLD);
 
+  // ranks beyond workers_per_node are reader ranks for the workers of their node when -N is given
+  int per_node_size;
+  MPI_Comm_size(per_node_comm, &per_node_size);
+  size_t const node_workers = std::min(args.workers_per_node, per_node_size);
+  bool const node_has_readers = args.reader_slots && per_node_size > args.workers_per_node;
+
   if (per_node_rank < args.workers_per_node) {
     try {
       hid_t fapl = check_hdf5(H5Pcreate(H5P_FILE_ACCESS));
       cleanup cleanup_fapl([&] { H5Pclose(fapl); });
-      check_hdf5(H5Pset_fapl_mpio(fapl, work_comm, MPI_INFO_NULL));
+      args.io.apply(fapl, work_comm);
 
       hid_t cxi = check_hdf5(H5Fopen(args.cxi_filename.c_str(), H5F_ACC_RDONLY, fapl));
       cleanup cleanup_cxi([&] { H5Fclose(cxi); });
@@ -188,6 +463,67 @@ int main(int argc, char* argv[]) {
       auto posy = open_dset(cxi, peaky_loc);
       auto npeaks = open_dset(cxi, npeak_loc);
 
+      // the compressor configuration is also needed to predict the memory of a chunk
+      std::ifstream pressio_input_file(args.pressio_config_file);
+      nlohmann::json j;
+      pressio_input_file >> j;
+      pressio_options options_from_file(static_cast<pressio_options>(j));
+
+      // align the chunks of events to the HDF5 chunks of the frames so no HDF5 chunk is read by two ranks
+      auto const data_layout = get_layout(data);
+      size_t const chunk_events = data_layout.chunked ? data_layout.chunk_dims.front() : 1;
+
+      memory_model memory;
+      memory.set_options(options_from_file);
+      {
+        auto const frame_dims = data.get_pressio_dims();
+        memory.frame_elements = frame_dims.at(0) * frame_dims.at(1);
+        memory.max_peaks = posx.get_dims_hsize().back();
+        // frames are always held as floats, whatever their type on disk
+        memory.element_size = sizeof(float);
+        memory.chunks_in_flight = args.pipeline_depth;
+        memory.frame_buffers =
+            node_has_readers ? std::max(args.reader_slots, args.pipeline_depth) : args.pipeline_depth;
+        memory.decompress = !args.output_file.empty();
+        if (args.peak_cache) {
+          memory.node_bytes = frame_dims.back() * (sizeof(int64_t) + 2 * memory.max_peaks * sizeof(double));
+        }
+      }
+      if (args.chunk_size == 0) {
+        // keep a tenth of the memory for everything the model does not count
+        size_t const node_budget = available_memory() / 10 * 9;
+        uint64_t fit = memory.chunk_size_for(node_budget, node_workers);
+        // no rank needs more than its share of the events
+        size_t const num_events = data.get_dims_hsize().front();
+        fit = std::min<uint64_t>(fit, (num_events + work_size - 1) / work_size);
+        // every rank must use the same chunk size, so the tightest node decides
+        MPI_Allreduce(MPI_IN_PLACE, &fit, 1, MPI_UINT64_T, MPI_MIN, work_comm);
+        args.chunk_size = std::max<size_t>(chunk_events, fit / chunk_events * chunk_events);
+        if (work_rank == 0) {
+          if (fit < chunk_events) {
+            logger("warning: even ", chunk_events, " events per chunk are predicted to exceed the available memory");
+          }
+          logger("chunk_size auto selected ", args.chunk_size, " predicted_rank_bytes=",
+                 memory.bytes_per_rank(args.chunk_size, node_workers), " node_budget_bytes=", node_budget);
+        }
+      }
+      if (args.chunk_size % chunk_events != 0) {
+        size_t const aligned = (args.chunk_size + chunk_events - 1) / chunk_events * chunk_events;
+        if (work_rank == 0) {
+          logger("chunk_size ", args.chunk_size, " is not a multiple of the ", chunk_events,
+                 " events per HDF5 chunk so chunks would be read by multiple ranks; using chunk_size ", aligned);
+        }
+        args.chunk_size = aligned;
+      }
+      bool const direct_reads = args.direct_chunks && data_layout.chunked && data_layout.filters == 0;
+      std::unique_ptr<raw_frame_reader> raw_reader;
+      if (args.raw_reads) {
+        raw_reader = raw_frame_reader::open(args.cxi_filename, data, *args.raw_reads);
+        if (!raw_reader && work_rank == 0) {
+          logger("frames are not stored contiguously as native floats; reading them with HDF5");
+        }
+      }
+
       hid_t output_h5f;
       cleanup cleanup_output_h5f;
       h5dset output_data;
@@ -197,31 +533,86 @@ int main(int argc, char* argv[]) {
         output_data = open_dset(output_h5f, data_loc);
       }
 
+      // load the peak tables once per node rather than reading them for every chunk
+      std::optional<peak_cache> peaks_cache;
+      if (args.peak_cache) {
+        peaks_cache.emplace(npeaks, posx, posy, node_work_comm, args.sparse_peaks);
+      }
+
       // hdf5 and libpressio use opposite data ordering
       size_t num_events = data.get_dims_hsize().front();
       args.write_events = std::min(args.write_events, num_events);
       size_t max_peaks = posx.get_dims_hsize().back();
       uint64_t total_size = 0;
       uint64_t total_compressed_size = 0;
-      pressio_data peaks_data = pressio_data::owning(pressio_int64_dtype, {args.chunk_size});
-      pressio_data posx_data = pressio_data::owning(pressio_double_dtype, {max_peaks, args.chunk_size});
-      pressio_data posy_data = pressio_data::owning(pressio_double_dtype, {max_peaks, args.chunk_size});
 
       auto data_lp_size = data.get_pressio_dims();
       auto data_lp_worksize = data_lp_size;
       data_lp_worksize.back() = args.chunk_size;
-      pressio_data data_data = pressio_data::owning(pressio_float_dtype, data_lp_worksize);
+
+      // the ring is only used if every node has readers, since the reads of lockstep schedules may be collective
+      int ring_everywhere = node_has_readers;
+      if (args.reader_slots) {
+        MPI_Allreduce(MPI_IN_PLACE, &ring_everywhere, 1, MPI_INT, MPI_LAND, work_comm);
+        if (!ring_everywhere && work_rank == 0) {
+          logger("-N needs more ranks than -n on every node; reading chunks on the workers");
+        }
+        if (ring_everywhere && args.reader_slots < args.pipeline_depth) {
+          if (work_rank == 0) {
+            logger("-N ", args.reader_slots, " is smaller than the pipeline depth; using ", args.pipeline_depth);
+          }
+          args.reader_slots = args.pipeline_depth;
+        }
+      }
+      std::optional<reader_ring> ring;
+      if (node_has_readers) {
+        reader_ring::shape shape;
+        shape.slots = ring_everywhere ? args.reader_slots : 0;
+        shape.chunk_size = args.chunk_size;
+        shape.max_peaks = max_peaks;
+        shape.frame_elements = data_lp_size.at(0) * data_lp_size.at(1);
+        ring.emplace(shape, node_workers, per_node_comm);
+        if (!ring->enabled()) ring.reset();
+      }
+      if (ring && (args.peak_cache || args.sparse_peaks) && work_rank == 0) {
+        logger("reader ranks read the padded peak tables, so -m and -S do not apply");
+      }
+
+      // frame, compressed and decompressed buffers are recycled between chunks rather than reallocated
+      buffer_pool pool(args.huge_pages);
+      uint64_t compressed_buffers_replaced = 0;
+
+      // each in-flight chunk owns its own set of buffers
+      std::vector<work_chunk> chunks(args.pipeline_depth);
+      for (auto& chunk : chunks) {
+        // with reader ranks the chunks are views of the ring
+        if (ring) continue;
+        if (!peaks_cache) {
+          chunk.peaks_data = pressio_data::owning(pressio_int64_dtype, {args.chunk_size});
+          chunk.posx_data = pressio_data::owning(pressio_double_dtype, {max_peaks, args.chunk_size});
+          chunk.posy_data = pressio_data::owning(pressio_double_dtype, {max_peaks, args.chunk_size});
+        }
+        chunk.data_data = pool.acquire(pressio_float_dtype, data_lp_worksize);
+      }
 
       // prepare compressor
-      std::ifstream pressio_input_file(args.pressio_config_file);
-      nlohmann::json j;
-      pressio_input_file >> j;
-      pressio_options options_from_file(static_cast<pressio_options>(j));
       pressio library;
       pressio_compressor comp = library.get_compressor("pressio");
       comp->set_name("pressio");
       comp->set_options(options_from_file);
 
+      // each compression thread compresses its parts of a chunk with its own clone of the configured compressor;
+      // -E needs a stream per event, so it makes every event a part even with a single thread
+      bool const event_parts = !args.filtered_file.empty();
+      std::vector<pressio_compressor> clones;
+      std::optional<thread_pool> compress_pool;
+      if (args.compress_threads > 1 || event_parts) {
+        for (size_t thread = 0; thread < args.compress_threads; ++thread) {
+          clones.emplace_back(pressio_compressor(comp->clone()));
+        }
+        compress_pool.emplace(args.compress_threads);
+      }
+
       auto const cxi_basename = basename(args.cxi_filename);
       auto const config_basename = basename(args.pressio_config_file);
       if (work_rank == 0) {
@@ -233,194 +624,726 @@ int main(int argc, char* argv[]) {
         logger("global npeaks", printer{npeaks.get_dims_hsize()});
       }
 
-      try {
-        auto begin = std::chrono::steady_clock::now();
-        uint64_t global_compress_ms = 0;
-        uint64_t global_decompress_ms = 0;
-        for (size_t i = 0; i < num_events; i += (args.chunk_size * work_size)) {
-          size_t id = i + work_rank * args.chunk_size;
-          size_t read_work_items;
-          if (id > num_events) {
-            read_work_items = 0;
-          } else if (id + args.chunk_size > num_events) {
-            read_work_items = num_events - id;
-          } else {
-            read_work_items = args.chunk_size;
+      std::unique_ptr<work_schedule> schedule;
+      weighted_schedule* weighted = nullptr;
+      adaptive_schedule* adaptive = nullptr;
+      if (args.schedule == "dynamic") {
+        schedule = std::make_unique<dynamic_schedule>(num_events, args.chunk_size, work_comm);
+      } else if (args.schedule == "adaptive") {
+        // the chunk buffers are allocated for args.chunk_size events, so it caps the adaptive chunk size
+        auto owned = std::make_unique<adaptive_schedule>(num_events, chunk_events, args.chunk_size, work_comm);
+        adaptive = owned.get();
+        schedule = std::move(owned);
+      } else if (args.schedule == "weighted") {
+        // read the nPeaks of every event once to balance the predicted cost of each rank
+        pressio_data all_npeaks;
+        if (peaks_cache) {
+          all_npeaks = peaks_cache->npeaks(0, num_events);
+        } else {
+          all_npeaks = pressio_data::owning(pressio_int64_dtype, {num_events});
+          read(npeaks, {0}, {num_events}, all_npeaks, num_events);
+        }
+        auto all_npeaks_ptr = static_cast<int64_t const*>(all_npeaks.data());
+        auto owned = std::make_unique<weighted_schedule>(
+            std::vector<int64_t>(all_npeaks_ptr, all_npeaks_ptr + num_events), args.cost, args.chunk_size,
+            work_comm, chunk_events);
+        weighted = owned.get();
+        schedule = std::move(owned);
+        if (args.debug) {
+          logger("weighted range ", weighted->begin(), " ", weighted->end(), " predicted_cost=",
+                 weighted->predicted_cost());
+        }
+      } else {
+        schedule = std::make_unique<static_schedule>(num_events, args.chunk_size, work_comm);
+      }
+      // ranks that do not advance in lockstep issue different numbers of reads and writes,
+      // so they must use independent rather than collective transfers
+      bool const lockstep = schedule->lockstep();
+      auto transfer_mode = [&](const char* loc) {
+        return lockstep ? args.io.transfer_mode(loc) : H5FD_MPIO_INDEPENDENT;
+      };
+      h5transfer npeaks_io(npeaks, transfer_mode(npeak_loc)), posx_io(posx, transfer_mode(peakx_loc)),
+          posy_io(posy, transfer_mode(peaky_loc)),
+          // direct chunk reads are independent, so the fallback reads must be too
+          data_io(data, direct_reads || raw_reader ? H5FD_MPIO_INDEPENDENT : transfer_mode(data_loc));
+      uint64_t direct_chunk_reads = 0;
+      std::optional<h5transfer> output_io;
+      if (!args.output_file.empty()) {
+        output_io.emplace(output_data, transfer_mode(data_loc));
+      }
+
+      std::optional<write_aggregator> aggregator;
+      if (!args.output_file.empty() && !args.aggregators.empty()) {
+        bool is_aggregator = false;
+        if (args.aggregators == "node") {
+          int node_work_rank;
+          MPI_Comm_rank(node_work_comm, &node_work_rank);
+          is_aggregator = node_work_rank == 0;
+        } else {
+          // spread the aggregators evenly over the work ranks
+          size_t const count = std::min<size_t>(atoi(args.aggregators.c_str()), work_size);
+          for (size_t i = 0; i < count; ++i) {
+            is_aggregator |= static_cast<size_t>(work_rank) == i * work_size / count;
           }
+        }
+        aggregator.emplace(output_data, is_aggregator, args.aggregator_buffer_mib << 20, pool, work_comm);
+      }
 
-          if (work_rank == 0) {
-            logger("processing ", i, " ", i + (args.chunk_size * work_size));
+      std::optional<compressed_archive> archive;
+      if (!args.archive_file.empty()) {
+        archive.emplace(args.archive_file, j.dump(), work_comm, lockstep, args.io);
+      }
+
+      std::optional<event_chunk_writer> filtered_writer;
+      if (!args.filtered_file.empty()) {
+        filtered_writer.emplace(args.filtered_file, data.get_dims_hsize(), j.dump(), work_comm, args.io);
+      }
+
+      // bytes of peak data the padded {work_items, max_peaks} reads would move vs. what was read
+      uint64_t peak_bytes_dense = 0;
+      uint64_t peak_bytes_read = peaks_cache ? peaks_cache->bytes_read() : 0;
+
+      // room for every phase of every chunk even if one rank processes all of the chunks
+      phase_trace trace;
+      constexpr size_t phases_per_chunk = 10;
+      if (!args.trace_file.empty()) {
+        size_t const smallest_chunk = adaptive ? chunk_events : args.chunk_size;
+        size_t const chunks = num_events / smallest_chunk + 2;
+        // compression threads record a compress and decompress phase for each part of a chunk
+        size_t const parts = !compress_pool ? 0 : event_parts ? num_events + chunks : chunks * args.compress_threads;
+        trace.start(phases_per_chunk * chunks + 2 * parts, work_comm);
+      }
+      // compression runs on the pipeline thread when pipelining
+      uint32_t const compute_thread = args.pipeline_depth > 1 ? 1 : 0;
+
+      centers_builder centers({data_lp_size.at(0), data_lp_size.at(1)});
+      centers_stats total_centers;
+
+      // reads nPeaks/posX/posY/data for the chunk and computes the roibin centers
+      auto read_chunk = [&](work_chunk& chunk) {
+        size_t const id = chunk.id;
+        size_t const read_work_items = chunk.read_work_items;
+        auto const begin_peaks = phase_trace::clock::now();
+        uint64_t const dense_bytes = read_work_items * (sizeof(int64_t) + 2 * max_peaks * sizeof(double));
+        peak_bytes_dense += dense_bytes;
+        chunk.sparse_peaks = args.sparse_peaks;
+        ring_slot slot;
+        if (ring) {
+          slot = ring->acquire();
+          if (slot.id != id || slot.work_items != read_work_items) {
+            throw std::logic_error("reader ring returned the wrong chunk");
           }
+          peak_bytes_read += dense_bytes;
+          chunk.sparse_peaks = false;
+          if (read_work_items) {
+            chunk.peaks_data = pressio_data::nonowning(pressio_int64_dtype, slot.npeaks, {read_work_items});
+            chunk.posx_data = pressio_data::nonowning(pressio_double_dtype, slot.posx, {max_peaks, read_work_items});
+            chunk.posy_data = pressio_data::nonowning(pressio_double_dtype, slot.posy, {max_peaks, read_work_items});
+          }
+        } else if (peaks_cache) {
+          size_t const cache_id = std::min(id, num_events);
+          chunk.peaks_data = peaks_cache->npeaks(cache_id, read_work_items);
+          chunk.posx_data = peaks_cache->posx(cache_id, read_work_items);
+          chunk.posy_data = peaks_cache->posy(cache_id, read_work_items);
+        } else if (args.sparse_peaks) {
+          // read npeaks, then only the valid columns of each event's posx/posy rows
+          std::vector<hsize_t> npeaks_start{id};
+          std::vector<hsize_t> npeaks_count{read_work_items};
+          if (read_work_items) {
+            chunk.peaks_data.set_dimensions({read_work_items});
+          }
+          npeaks_io.read(npeaks_start, npeaks_count, chunk.peaks_data, read_work_items);
+          peak_bytes_read += read_work_items * sizeof(int64_t);
 
+          auto npeaks_ptr = static_cast<const int64_t*>(chunk.peaks_data.data());
+          size_t peaks_in_work = 0;
+          for (size_t k = 0; k < read_work_items; ++k) {
+            peaks_in_work += std::max<int64_t>(npeaks_ptr[k], 0);
+          }
+          chunk.posx_data.set_dimensions({peaks_in_work});
+          chunk.posy_data.set_dimensions({peaks_in_work});
+          peak_bytes_read += read_row_prefixes(posx, id, npeaks_ptr, read_work_items, chunk.posx_data,
+                                               transfer_mode(peakx_loc));
+          peak_bytes_read += read_row_prefixes(posy, id, npeaks_ptr, read_work_items, chunk.posy_data,
+                                               transfer_mode(peaky_loc));
+        } else {
+          peak_bytes_read += dense_bytes;
           // read npeaks
           std::vector<hsize_t> npeaks_start{id};
           std::vector<hsize_t> npeaks_count{read_work_items};
           std::vector<size_t> peak_data_lp(npeaks_count.begin(), npeaks_count.end());
           if (read_work_items) {
-            peaks_data.set_dimensions(std::move(peak_data_lp));
+            chunk.peaks_data.set_dimensions(std::move(peak_data_lp));
           }
-          read(npeaks, npeaks_start, npeaks_count, peaks_data, read_work_items);
+          npeaks_io.read(npeaks_start, npeaks_count, chunk.peaks_data, read_work_items);
           // read posx
           std::vector<hsize_t> posx_start{id, 0};
           std::vector<hsize_t> posx_count{read_work_items, max_peaks};
           std::vector<size_t> posx_data_lp(posx_count.begin(), posx_count.end());
           if (read_work_items) {
-            posx_data.set_dimensions(std::move(posx_data_lp));
+            chunk.posx_data.set_dimensions(std::move(posx_data_lp));
           }
-          read(posx, posx_start, posx_count, posx_data, read_work_items);
+          posx_io.read(posx_start, posx_count, chunk.posx_data, read_work_items);
           // read posy
           std::vector<hsize_t> posy_start{id, 0};
           std::vector<hsize_t> posy_count{read_work_items, max_peaks};
           std::vector<size_t> posy_data_lp(posy_count.begin(), posy_count.end());
           if (read_work_items) {
-            posy_data.set_dimensions(std::move(posy_data_lp));
+            chunk.posy_data.set_dimensions(std::move(posy_data_lp));
           }
-          read(posy, posy_start, posy_count, posy_data, read_work_items);
+          posy_io.read(posy_start, posy_count, chunk.posy_data, read_work_items);
+        }
 
-          // compute centers
-          size_t peaks_in_work = 0;
-          auto npeaks_ptr = static_cast<const int64_t*>(peaks_data.data());
-          std::vector<size_t> peaks_to_events, to_start_of_event;
-          peaks_to_events.reserve(max_peaks * read_work_items);
-          to_start_of_event.reserve(read_work_items * read_work_items);
-          for (size_t k = 0; k < read_work_items; ++k) {
-            peaks_in_work += npeaks_ptr[k];
-            for (int64_t j = 0; j < npeaks_ptr[k]; ++j) {
-              peaks_to_events.push_back(k);
-              to_start_of_event.push_back(j);
+        trace.record("read_peaks", id, begin_peaks);
+
+        // compute centers
+        auto const begin_centers = phase_trace::clock::now();
+        auto const stats = centers.build(
+            static_cast<const int64_t*>(chunk.peaks_data.data()), read_work_items,
+            static_cast<double const*>(chunk.posx_data.data()), static_cast<double const*>(chunk.posy_data.data()),
+            chunk.sparse_peaks ? 0 : max_peaks, chunk.centers);
+        total_centers += stats;
+        trace.record("centers", id, begin_centers);
+        if(args.debug) {
+            logger("npeaks: ", id, ' ', stats.peaks, " clamped=", stats.clamped, " dropped=", stats.dropped);
+        }
+
+        // read data
+        auto const begin_data = phase_trace::clock::now();
+        std::vector<hsize_t> const data_start{id, 0, 0};
+        std::vector<hsize_t> const data_count{read_work_items, data_lp_worksize.at(1), data_lp_worksize.at(0)};
+        if (read_work_items && !ring) {
+          std::vector<size_t>  data_data_lp(data_count.rbegin(), data_count.rend());
+          chunk.data_data.set_dimensions(std::move(data_data_lp));
+        }
+        try {
+          if (ring) {
+            if (read_work_items) {
+              chunk.data_data = pressio_data::nonowning(
+                  pressio_float_dtype, slot.frames, {data_lp_worksize.at(0), data_lp_worksize.at(1), read_work_items});
             }
+          } else if (raw_reader) {
+            raw_reader->read(id, read_work_items, chunk.data_data);
+          } else if (direct_reads && read_work_items &&
+              read_chunks_direct(data, data_layout, id, read_work_items, chunk.data_data)) {
+            ++direct_chunk_reads;
+          } else {
+            data_io.read(data_start, data_count, chunk.data_data, read_work_items, args.debug);
           }
-          if(args.debug) {
-              logger("npeaks: ", id, ' ', peaks_in_work);
-          }
-          pressio_data centers = pressio_data::owning(pressio_uint64_dtype, {3, peaks_in_work});
-          auto posx_ptr = static_cast<double const*>(posx_data.data());
-          auto posy_ptr = static_cast<double const*>(posy_data.data());
-          auto centers_ptr = static_cast<uint64_t*>(centers.data());
-          for (size_t k = 0; k < peaks_in_work; ++k) {
-            centers_ptr[k * 3] =
-                static_cast<size_t>(posx_ptr[peaks_to_events[k] * max_peaks + to_start_of_event[k]]);
-            centers_ptr[k * 3 + 1] =
-                static_cast<size_t>(posy_ptr[peaks_to_events[k] * max_peaks + to_start_of_event[k]]);
-            centers_ptr[k * 3 + 2] = peaks_to_events[k];
-          }
-
-          // read data
-          std::vector<hsize_t> const data_start{id, 0, 0};
-          std::vector<hsize_t> const data_count{read_work_items, data_lp_worksize.at(1), data_lp_worksize.at(0)};
-          if (read_work_items) {
-            std::vector<size_t>  data_data_lp(data_count.rbegin(), data_count.rend());
-            data_data.set_dimensions(std::move(data_data_lp));
+        } catch (std::exception const& ex) {
+          logger("read failed", ex.what());
+          MPI_Abort(MPI_COMM_WORLD , 1);
+        }
+        trace.record("read_data", id, begin_data);
+      };
+
+      // chunks of the adaptive schedule vary in size, so this is bounded by the chunk's own events
+      auto write_work_items = [&](work_chunk const& chunk) -> size_t {
+        if (chunk.id >= args.write_events) {
+          return 0;
+        }
+        return std::min(chunk.read_work_items, args.write_events - chunk.id);
+      };
+
+      // splits the chunk into one run of consecutive events per compression thread, or one per event for -E,
+      // and compresses, and if requested decompresses, the runs concurrently; the chunk's times are those of
+      // its slowest thread
+      auto compress_parts = [&](work_chunk& chunk) {
+        size_t const events = chunk.read_work_items;
+        size_t const nparts = event_parts ? events : std::min(events, clones.size());
+        size_t const ntasks = std::min(nparts, clones.size());
+        auto const frame_dims = chunk.data_data.dimensions();
+        size_t const frame_bytes = frame_dims.at(0) * frame_dims.at(1) * pressio_dtype_size(chunk.data_data.dtype());
+        auto const* chunk_centers = static_cast<uint64_t const*>(chunk.centers.data());
+        size_t const num_centers = chunk.centers.num_elements() / 3;
+        chunk.parts.resize(nparts);
+        size_t center = 0;
+        for (size_t p = 0; p < nparts; ++p) {
+          auto& part = chunk.parts[p];
+          part.first = p * events / nparts;
+          part.events = (p + 1) * events / nparts - part.first;
+          // the centers are ordered by event
+          part.centers.clear();
+          for (; center < num_centers && chunk_centers[3 * center + 2] < part.first + part.events; ++center) {
+            part.centers.insert(part.centers.end(), {chunk_centers[3 * center], chunk_centers[3 * center + 1],
+                                                     chunk_centers[3 * center + 2] - part.first});
           }
-          try {
-            //logger("loading: ", id, " start=", printer(data_start), " count=", printer(data_count),  " items=", read_work_items);
-            read(data, data_start, data_count, data_data, read_work_items, args.debug);
-            //logger("loaded: ", id, " start=", printer(data_start), " count=", printer(data_count),  " items=", read_work_items);
-          } catch (std::exception const& ex) {
-            logger("read failed", ex.what());
-            MPI_Abort(MPI_COMM_WORLD , 1);
-          }
-
-          uint64_t compress_time_ms = 0;
-          uint64_t decompress_time_ms = 0;
-          pressio_data data_comp = pressio_data::empty(pressio_byte_dtype, {});
-          if (read_work_items > 0) {
-            // trigger compression/decompression
-            comp->set_options({{"roibin:centers", std::move(centers)}});
-            auto begin_compress = std::chrono::steady_clock::now();
-            if (comp->compress(&data_data, &data_comp)) {
-              logger(comp->error_msg());
-              MPI_Abort(MPI_COMM_WORLD, comp->error_code());
+          // the pool is shared with the threads, so buffers are acquired here rather than in the tasks
+          part.compressed = pool.acquire(pressio_byte_dtype, {part.events * frame_bytes});
+          chunk.pooled.push_back(part.compressed.data());
+        }
+
+        bool const decompress = !args.output_file.empty() && write_work_items(chunk) > 0;
+        auto* input = static_cast<char*>(chunk.data_data.data());
+        auto* output = decompress ? static_cast<char*>(chunk.data_output.data()) : nullptr;
+        std::vector<std::future<std::array<uint64_t, 2>>> parts_done;
+        for (size_t t = 0; t < ntasks; ++t) {
+          // task t compresses parts t, t+ntasks, ... with clone t, so no clone is used by two threads at once
+          parts_done.push_back(compress_pool->submit([&, t]() -> std::array<uint64_t, 2> {
+            auto& clone = clones[t];
+            std::chrono::steady_clock::duration compress_time{0}, decompress_time{0};
+            for (size_t p = t; p < nparts; p += ntasks) {
+              auto& part = chunk.parts[p];
+              std::vector<size_t> const dims{frame_dims.at(0), frame_dims.at(1), part.events};
+              auto in = pressio_data::nonowning(chunk.data_data.dtype(), input + part.first * frame_bytes, dims);
+              clone->set_options({{"roibin:centers", pressio_data::nonowning(pressio_uint64_dtype,
+                                                                              part.centers.data(),
+                                                                              {3, part.centers.size() / 3})}});
+              auto const begin_compress = std::chrono::steady_clock::now();
+              if (clone->compress(&in, &part.compressed)) {
+                throw std::runtime_error(clone->error_msg());
+              }
+              auto const begin_decompress = std::chrono::steady_clock::now();
+              // the trace threads of the tasks follow the main and pipeline threads
+              trace.record("compress", chunk.id, begin_compress, 2 + t);
+              compress_time += begin_decompress - begin_compress;
+              if (output) {
+                auto out = pressio_data::nonowning(chunk.data_data.dtype(), output + part.first * frame_bytes, dims);
+                if (clone->decompress(&part.compressed, &out)) {
+                  throw std::runtime_error(clone->error_msg());
+                }
+                trace.record("decompress", chunk.id, begin_decompress, 2 + t);
+                decompress_time += std::chrono::steady_clock::now() - begin_decompress;
+              }
             }
-            auto end_compress = std::chrono::steady_clock::now();
-            compress_time_ms =
-                std::chrono::duration_cast<std::chrono::milliseconds>(end_compress - begin_compress).count();
+            return {static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(compress_time).count()),
+                    static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(decompress_time).count())};
+          }));
+        }
+        // wait for every part before rethrowing so no task still refers to the chunk
+        std::exception_ptr error;
+        for (auto& done : parts_done) {
+          try {
+            auto const ms = done.get();
+            chunk.compress_time_ms = std::max(chunk.compress_time_ms, ms[0]);
+            chunk.decompress_time_ms = std::max(chunk.decompress_time_ms, ms[1]);
+          } catch (...) {
+            if (!error) error = std::current_exception();
           }
+        }
+        if (error) std::rethrow_exception(error);
+      };
 
+      // compresses, and if requested decompresses, the chunk
+      //
+      // this may run on the pipeline thread, so it MUST NOT call MPI (including logger);
+      // errors are reported by throwing and re-thrown to the main thread from chunk.compressed
+      auto compress_chunk = [&](work_chunk& chunk) {
+        chunk.compress_time_ms = 0;
+        chunk.decompress_time_ms = 0;
+        chunk.data_comp = pressio_data::empty(pressio_byte_dtype, {});
+        chunk.pooled_comp = nullptr;
+        chunk.parts.clear();
+        if (compress_pool && chunk.read_work_items > 0) {
           if (!args.output_file.empty()) {
-            size_t write_work_items;
-            if (id > args.write_events) {
-              write_work_items = 0;
-            } else if (id + args.chunk_size > args.write_events) {
-              write_work_items = num_events - id;
+            chunk.data_output = pool.acquire(chunk.data_data.dtype(), chunk.data_data.dimensions());
+            chunk.pooled.push_back(chunk.data_output.data());
+          }
+          compress_parts(chunk);
+        } else if (chunk.read_work_items > 0) {
+          // offer the compressor a pooled buffer as large as the input; compressors that allocate
+          // their own output replace the view instead
+          chunk.data_comp = pool.acquire(pressio_byte_dtype, {chunk.data_data.size_in_bytes()});
+          chunk.pooled_comp = chunk.data_comp.data();
+          chunk.pooled.push_back(chunk.pooled_comp);
+          // trigger compression/decompression
+          // hand the compressor a view so the centers buffer is reused by the next read of this chunk
+          comp->set_options({{"roibin:centers", pressio_data::nonowning(pressio_uint64_dtype, chunk.centers.data(),
+                                                                         chunk.centers.dimensions())}});
+          auto begin_compress = std::chrono::steady_clock::now();
+          if (comp->compress(&chunk.data_data, &chunk.data_comp)) {
+            throw std::runtime_error(comp->error_msg());
+          }
+          auto end_compress = std::chrono::steady_clock::now();
+          chunk.compress_time_ms =
+              std::chrono::duration_cast<std::chrono::milliseconds>(end_compress - begin_compress).count();
+          trace.record("compress", chunk.id, begin_compress, compute_thread);
+        }
+
+        if (!args.output_file.empty() && chunk.parts.empty()) {
+          // only the shape is needed, so do not copy the input
+          chunk.data_output = pool.acquire(chunk.data_data.dtype(), chunk.data_data.dimensions());
+          chunk.pooled.push_back(chunk.data_output.data());
+          if (write_work_items(chunk) > 0) {
+            auto begin_decompress = std::chrono::steady_clock::now();
+            if (comp->decompress(&chunk.data_comp, &chunk.data_output)) {
+              throw std::runtime_error(comp->error_msg());
+            }
+            auto end_decompress = std::chrono::steady_clock::now();
+            chunk.decompress_time_ms =
+                std::chrono::duration_cast<std::chrono::milliseconds>(end_decompress - begin_decompress)
+                    .count();
+            trace.record("decompress", chunk.id, begin_decompress, compute_thread);
+          }
+        }
+        if (args.debug) {
+          // with compression threads these are the metrics of the first part
+          chunk.metrics_results =
+              chunk.parts.empty() ? comp->get_metrics_results() : clones.front()->get_metrics_results();
+        }
+      };
+
+      // writes the decompressed chunk and accumulates the metrics for the chunk
+      //
+      // timings are only recorded locally here and reduced once after the loop, so no rank waits on
+      // the others for bookkeeping
+      uint64_t global_compress_ms = 0;
+      uint64_t global_decompress_ms = 0;
+      std::vector<uint64_t> step_compress_ms;
+      std::vector<uint64_t> step_decompress_ms;
+      std::chrono::duration<double, std::milli> flush_ms{0};
+      std::vector<kept_chunk> kept;
+      uint64_t flush_count = 0;
+      auto write_chunk = [&](work_chunk& chunk) {
+        size_t const id = chunk.id;
+        size_t const read_work_items = chunk.read_work_items;
+        if (!args.output_file.empty()) {
+          size_t const write_items = write_work_items(chunk);
+          // now write out the data to save
+          std::vector<hsize_t> write_data_start{id, 0, 0};
+          std::vector<hsize_t> write_data_count{write_items, data_lp_worksize.at(1),
+                                                data_lp_worksize.at(0)};
+          if(args.debug_buffers){
+              std::stringstream ss;
+              ss << args.debug_dir << cxi_basename << '-' << config_basename << '-' << id << '-'
+                 << (id + read_work_items) << ".bin";
+              std::string debug_buffers_filename = ss.str();
+              pressio_io posix = library.get_io("posix");
+              posix->set_options({
+                      {"io:path", debug_buffers_filename}
+                  });
+              logger("writing output buffer ", id);
+              posix->write(&chunk.data_output);
+              logger("done writing output buffer ", id);
+          }
+          if(args.debug) {
+              logger("commiting: ", id, " start=", printer(write_data_start), " count=", printer(write_data_count),  " items=", write_items);
+          }
+          try {
+            auto const begin_write = phase_trace::clock::now();
+            if (aggregator) {
+              // the aggregators write the frames once they arrive, so the buffer is released after it is sent
+              void const* pooled_output = nullptr;
+              auto pooled = std::find(chunk.pooled.begin(), chunk.pooled.end(), chunk.data_output.data());
+              if (pooled != chunk.pooled.end()) {
+                pooled_output = *pooled;
+                chunk.pooled.erase(pooled);
+              }
+              if (write_items) {
+                aggregator->send(id, write_items, std::move(chunk.data_output), pooled_output);
+              } else if (pooled_output) {
+                pool.release(pooled_output);
+              }
+              aggregator->progress();
             } else {
-              write_work_items = args.chunk_size;
+              output_io->write(write_data_start, write_data_count, chunk.data_output, write_items, args.debug);
+            }
+            trace.record("write", id, begin_write);
+            // H5Fflush is collective, so without lockstep the file is only flushed when it is closed; the
+            // aggregators write at their own pace, so with them it is also only flushed when it is closed
+            if (lockstep && !aggregator && args.flush.due(work_comm)) {
+              auto const begin_flush = phase_trace::clock::now();
+              check_hdf5(H5Fflush(output_h5f, H5F_SCOPE_GLOBAL));
+              flush_ms += phase_trace::clock::now() - begin_flush;
+              ++flush_count;
+              trace.record("flush", id, begin_flush);
             }
+          } catch(std::exception const& ex ) {
+            logger("write failed: ", ex.what());
+            MPI_Abort(MPI_COMM_WORLD, 1);
+          }
+          if(args.debug) {
+              logger("commited: ", id);
+          }
+        }
+
+        if (archive && !chunk.parts.empty()) {
+          std::vector<uint64_t> first_events, n_events;
+          std::vector<pressio_data const*> streams;
+          for (auto const& part : chunk.parts) {
+            first_events.push_back(id + part.first);
+            n_events.push_back(part.events);
+            streams.push_back(&part.compressed);
+          }
+          archive->append(first_events, n_events, streams);
+        } else if (archive) {
+          archive->append(id, read_work_items, chunk.data_comp);
+        }
+        if (args.decompress_repeats && read_work_items) {
+          if (chunk.parts.empty()) {
+            kept.push_back(kept_chunk{pressio_data::clone(chunk.data_comp), pressio_data::clone(chunk.centers),
+                                      chunk.data_data.dimensions(), chunk.data_data.dtype()});
+          }
+          for (auto const& part : chunk.parts) {
+            auto dims = chunk.data_data.dimensions();
+            dims.back() = part.events;
+            kept.push_back(kept_chunk{pressio_data::clone(part.compressed),
+                                      pressio_data::copy(pressio_uint64_dtype, part.centers.data(),
+                                                         {3, part.centers.size() / 3}),
+                                      dims, chunk.data_data.dtype()});
+          }
+        }
+        if (filtered_writer) {
+          // every part is the compressed stream of one event, so it only needs the filter's header and centers
+          auto const begin_events = phase_trace::clock::now();
+          auto dims = chunk.data_data.dimensions();
+          dims.back() = 1;
+          for (auto const& part : chunk.parts) {
+            filtered_writer->write_event(
+                id + part.first, roibin_h5filter_encode(part.centers, dims, chunk.data_data.dtype(), part.compressed));
+          }
+          trace.record("write_events", id, begin_events);
+        }
+
+        // save metrics worth saving
+        total_compressed_size += chunk.data_comp.size_in_bytes();
+        for (auto& part : chunk.parts) {
+          total_compressed_size += part.compressed.size_in_bytes();
+          part.compressed = pressio_data::empty(pressio_byte_dtype, {});
+        }
+        total_size += chunk.data_data.size_in_bytes();
+        if (args.debug) {
+          nlohmann::json jmr = chunk.metrics_results;
+          std::stringstream ss;
+          ss << args.debug_dir << cxi_basename << '-' << config_basename << '-' << id << '-'
+             << (id + read_work_items) << ".json";
+          logger(ss.rdbuf());
+          std::ofstream out(ss.str());
+          out << jmr;
+        }
+
+        // the chunk is written, so its pooled buffers can be handed to the next chunk
+        if (chunk.pooled_comp && chunk.data_comp.data() != chunk.pooled_comp) {
+          ++compressed_buffers_replaced;
+        }
+        chunk.data_comp = pressio_data::empty(pressio_byte_dtype, {});
+        chunk.data_output = pressio_data::empty(pressio_byte_dtype, {});
+        for (auto* buffer : chunk.pooled) {
+          pool.release(buffer);
+        }
+        chunk.pooled.clear();
+        chunk.pooled_comp = nullptr;
+        if (ring) {
+          ring->release();
+        }
+
+        if (!lockstep) {
+          // ranks process different numbers of chunks, so reduce the per-rank totals once at the end
+          global_compress_ms += chunk.compress_time_ms;
+          global_decompress_ms += chunk.decompress_time_ms;
+          return;
+        }
+        step_compress_ms.push_back(chunk.compress_time_ms);
+        step_decompress_ms.push_back(chunk.decompress_time_ms);
+      };
 
-            pressio_data data_output = pressio_data::clone(data_data);
-            if (write_work_items > 0) {
-              auto begin_decompress = std::chrono::steady_clock::now();
-              if (comp->decompress(&data_comp, &data_output)) {
-                logger(comp->error_msg());
-                MPI_Abort(MPI_COMM_WORLD, comp->error_code());
+      try {
+        auto begin = std::chrono::steady_clock::now();
+
+        // with a pipeline depth of d, the chunk issued at step s is read and handed to the compression
+        // thread at step s and written at step s+d-1, so up to d chunks are in flight.  All HDF5 and
+        // MPI calls stay on this thread in the same order on every rank so the collective calls still
+        // match for lockstep schedules.
+        size_t const depth = args.pipeline_depth;
+        std::optional<thread_pool> pipeline;
+        if (depth > 1) pipeline.emplace(1);
+        using ms_t = std::chrono::duration<double, std::milli>;
+        ms_t io_ms{0}, compute_ms{0}, wait_ms{0};
+
+        // with reader ranks, ranges are requested as soon as a slot is free so the readers can read ahead
+        std::deque<work_range> requested;
+        std::optional<work_range> unrequested;
+        bool scheduled_all = false;
+        auto next_range = [&](work_range& range) {
+          if (!ring) return schedule->next(range);
+          while (!scheduled_all) {
+            if (!unrequested) {
+              work_range ahead;
+              if (!schedule->next(ahead)) {
+                scheduled_all = true;
+                ring->finish();
+                break;
               }
-              auto end_decompress = std::chrono::steady_clock::now();
-              decompress_time_ms =
-                  std::chrono::duration_cast<std::chrono::milliseconds>(end_decompress - begin_decompress)
-                      .count();
+              unrequested = ahead;
             }
+            if (!ring->request(*unrequested)) break;
+            requested.push_back(*unrequested);
+            unrequested.reset();
+          }
+          if (requested.empty()) return false;
+          range = requested.front();
+          requested.pop_front();
+          return true;
+        };
+
+        size_t issued = 0, retired = 0;
+        bool more_work = true;
+        while (more_work || retired < issued) {
+          work_range range;
+          if (more_work && (more_work = next_range(range))) {
+            auto& chunk = chunks[issued++ % depth];
+            chunk.id = range.id;
+            chunk.read_work_items = range.work_items;
 
-            // now write out the data to save
-            std::vector<hsize_t> write_data_start{id, 0, 0};
-            std::vector<hsize_t> write_data_count{write_work_items, data_lp_worksize.at(1),
-                                                  data_lp_worksize.at(0)};
-            if(args.debug_buffers){
-                std::stringstream ss;
-                ss << args.debug_dir << cxi_basename << '-' << config_basename << '-' << id << '-'
-                   << (id + read_work_items) << ".bin";
-                std::string debug_buffers_filename = ss.str();
-                pressio_io posix = library.get_io("posix");
-                posix->set_options({
-                        {"io:path", debug_buffers_filename}
-                    });
-                logger("writing output buffer ", id);
-                posix->write(&data_output);
-                logger("done writing output buffer ", id);
+            if (lockstep && work_rank == 0) {
+              logger("processing ", range.id, " ", range.id + (args.chunk_size * work_size));
+            } else if (!lockstep && args.debug) {
+              logger("processing ", range.id, " ", range.id + range.work_items);
             }
-            if(args.debug) {
-                logger("commiting: ", id, " start=", printer(write_data_start), " count=", printer(write_data_count),  " items=", write_work_items);
+
+            auto begin_read = std::chrono::steady_clock::now();
+            read_chunk(chunk);
+            io_ms += std::chrono::steady_clock::now() - begin_read;
+
+            auto timed_compress = [&compress_chunk, &compute_ms, &chunk] {
+              auto begin_compute = std::chrono::steady_clock::now();
+              compress_chunk(chunk);
+              compute_ms += std::chrono::steady_clock::now() - begin_compute;
+            };
+            if (pipeline) {
+              chunk.compressed = pipeline->submit(timed_compress);
+            } else {
+              std::promise<void> done;
+              timed_compress();
+              done.set_value();
+              chunk.compressed = done.get_future();
             }
+          }
+
+          if (issued - retired == depth || (!more_work && retired < issued)) {
+            auto& chunk = chunks[retired++ % depth];
+            auto begin_wait = std::chrono::steady_clock::now();
             try {
-              write(output_data, write_data_start, write_data_count, data_output, write_work_items, args.debug);
-              H5Fflush(output_h5f, H5F_SCOPE_GLOBAL);
-            } catch(std::exception const& ex ) {
-              logger("write failed: ", ex.what());
+              chunk.compressed.get();
+            } catch (std::exception const& ex) {
+              logger(ex.what());
               MPI_Abort(MPI_COMM_WORLD, 1);
             }
-            if(args.debug) {
-                logger("commited: ", id);
+            auto begin_write = std::chrono::steady_clock::now();
+            wait_ms += begin_write - begin_wait;
+            trace.record("wait", chunk.id, begin_wait);
+            write_chunk(chunk);
+            io_ms += std::chrono::steady_clock::now() - begin_write;
+            if (adaptive) {
+              size_t const before = adaptive->chunk_size();
+              adaptive->observe(chunk.id, chunk.read_work_items * memory.frame_elements * memory.element_size);
+              if (adaptive->chunk_size() != before) {
+                logger("adaptive chunk_size ", before, " -> ", adaptive->chunk_size(), " at event ", chunk.id,
+                       " rate_GBps=", adaptive->changes().back().rate_GBps);
+              }
             }
           }
+        }
 
-          // save metrics worth saving
-          total_compressed_size += data_comp.size_in_bytes();
-          total_size += data_data.size_in_bytes();
-          if (args.debug) {
-            auto metrics_results = comp->get_metrics_results();
-            nlohmann::json jmr = metrics_results;
-            std::stringstream ss;
-            ss << args.debug_dir << cxi_basename << '-' << config_basename << '-' << id << '-'
-               << (id + read_work_items) << ".json";
-            logger(ss.rdbuf());
-            std::ofstream out(ss.str());
-            out << jmr;
-          }
-          uint64_t longest_compress_ms;
-          MPI_Reduce(&compress_time_ms, &longest_compress_ms, 1, MPI_UINT64_T, MPI_MAX, 0, work_comm);
-          global_compress_ms += longest_compress_ms;
+        if (aggregator) {
+          aggregator->finish();
+        }
+        if (filtered_writer) {
+          filtered_writer->finish();
+        }
+        if (archive) {
+          archive->finish();
+        }
 
-          if (!args.output_file.empty()) {
-            uint64_t longest_decompress_ms;
-            MPI_Reduce(&decompress_time_ms, &longest_decompress_ms, 1, MPI_UINT64_T, MPI_MAX, 0, work_comm);
-            global_decompress_ms += longest_decompress_ms;
+        if (lockstep) {
+          // every rank retired the same number of steps; the reported time is the sum over steps of the
+          // slowest rank in each step, as when the steps were reduced one at a time
+          size_t const steps = step_compress_ms.size();
+          std::vector<uint64_t> step_ms(step_compress_ms);
+          step_ms.insert(step_ms.end(), step_decompress_ms.begin(), step_decompress_ms.end());
+          std::vector<uint64_t> longest_step_ms(step_ms.size());
+          MPI_Reduce(step_ms.data(), longest_step_ms.data(), step_ms.size(), MPI_UINT64_T, MPI_MAX, 0, work_comm);
+          for (size_t step = 0; step < steps; ++step) {
+            global_compress_ms += longest_step_ms[step];
+            global_decompress_ms += longest_step_ms[steps + step];
           }
+        } else {
+          std::array<uint64_t, 2> local_ms{global_compress_ms, global_decompress_ms};
+          std::array<uint64_t, 2> longest_ms{0, 0};
+          MPI_Reduce(local_ms.data(), longest_ms.data(), local_ms.size(), MPI_UINT64_T, MPI_MAX, 0, work_comm);
+          global_compress_ms = longest_ms[0];
+          global_decompress_ms = longest_ms[1];
         }
 
+        std::array<uint64_t, 4> peak_counts{peak_bytes_dense, peak_bytes_read, total_centers.clamped,
+                                           total_centers.dropped};
+        std::array<uint64_t, 4> global_peak_counts{0, 0, 0, 0};
+        MPI_Reduce(peak_counts.data(), global_peak_counts.data(), peak_counts.size(), MPI_UINT64_T, MPI_SUM, 0,
+                   work_comm);
+
+        double const local_flush_ms = flush_ms.count();
+        double longest_flush_ms = 0;
+        MPI_Reduce(&local_flush_ms, &longest_flush_ms, 1, MPI_DOUBLE, MPI_MAX, 0, work_comm);
+
+        uint64_t global_direct_chunk_reads = 0;
+        MPI_Reduce(&direct_chunk_reads, &global_direct_chunk_reads, 1, MPI_UINT64_T, MPI_SUM, 0, work_comm);
+        // readers are counted once per node
+        uint64_t const node_readers = (ring && per_node_rank == 0) ? ring->num_readers() : 0;
+        uint64_t global_readers = 0;
+        MPI_Reduce(&node_readers, &global_readers, 1, MPI_UINT64_T, MPI_SUM, 0, work_comm);
+        double const reader_wait_ms = ring ? ring->wait_seconds() * 1e3 : 0;
+        double longest_reader_wait_ms = 0;
+        MPI_Reduce(&reader_wait_ms, &longest_reader_wait_ms, 1, MPI_DOUBLE, MPI_MAX, 0, work_comm);
+        auto const aggregator_stats = aggregator ? aggregator->stats() : write_aggregator_stats{};
+        std::array<uint64_t, 2> aggregated_counts{aggregator_stats.writes, aggregator_stats.bytes_written};
+        std::array<uint64_t, 2> global_aggregated_counts{0, 0};
+        MPI_Reduce(aggregated_counts.data(), global_aggregated_counts.data(), aggregated_counts.size(), MPI_UINT64_T,
+                   MPI_SUM, 0, work_comm);
+        double longest_aggregated_write_seconds = 0;
+        MPI_Reduce(&aggregator_stats.write_seconds, &longest_aggregated_write_seconds, 1, MPI_DOUBLE, MPI_MAX, 0,
+                   work_comm);
+        // only the writing rank of the filtered file writes, so the sums are its counts and time, while the
+        // wait in finish is the cost of the funnel to the slowest rank
+        auto const filtered_stats = filtered_writer ? filtered_writer->stats() : event_chunk_writer_stats{};
+        std::array<uint64_t, 2> filtered_counts{filtered_stats.writes, filtered_stats.bytes_written};
+        std::array<uint64_t, 2> global_filtered_counts{0, 0};
+        MPI_Reduce(filtered_counts.data(), global_filtered_counts.data(), filtered_counts.size(), MPI_UINT64_T,
+                   MPI_SUM, 0, work_comm);
+        std::array<double, 2> filtered_seconds{filtered_stats.write_seconds, filtered_stats.finish_seconds};
+        std::array<double, 2> global_filtered_seconds{0, 0};
+        MPI_Reduce(&filtered_seconds[0], &global_filtered_seconds[0], 1, MPI_DOUBLE, MPI_SUM, 0, work_comm);
+        MPI_Reduce(&filtered_seconds[1], &global_filtered_seconds[1], 1, MPI_DOUBLE, MPI_MAX, 0, work_comm);
+        // the model's prediction for the chunk size that was used next to what the largest rank really needed
+        std::array<uint64_t, 2> rank_bytes{memory.bytes_per_rank(args.chunk_size, node_workers), peak_rss()};
+        std::array<uint64_t, 2> largest_rank_bytes{0, 0};
+        MPI_Reduce(rank_bytes.data(), largest_rank_bytes.data(), rank_bytes.size(), MPI_UINT64_T, MPI_MAX, 0,
+                   work_comm);
+
+        // chunk sizes chosen after the first one, and the largest size any rank settled on
+        std::array<uint64_t, 2> adaptive_counts{adaptive ? adaptive->changes().size() - 1 : 0,
+                                                adaptive ? adaptive->chunk_size() : 0};
+        std::array<uint64_t, 2> global_adaptive_counts{0, 0};
+        MPI_Reduce(&adaptive_counts[0], &global_adaptive_counts[0], 1, MPI_UINT64_T, MPI_SUM, 0, work_comm);
+        MPI_Reduce(&adaptive_counts[1], &global_adaptive_counts[1], 1, MPI_UINT64_T, MPI_MAX, 0, work_comm);
+
+        auto const pool_stats = pool.stats();
+        std::array<uint64_t, 3> pool_counts{pool_stats.bytes_allocated, pool_stats.bytes_reused,
+                                            compressed_buffers_replaced};
+        std::array<uint64_t, 3> global_pool_counts{0, 0, 0};
+        MPI_Reduce(pool_counts.data(), global_pool_counts.data(), pool_counts.size(), MPI_UINT64_T, MPI_SUM, 0,
+                   work_comm);
+
         auto global_compressed_size = total_compressed_size;
         auto global_total_size = total_compressed_size;
         MPI_Reduce(&total_compressed_size, &global_compressed_size, 1, MPI_UINT64_T, MPI_SUM, 0, work_comm);
         MPI_Reduce(&total_size, &global_total_size, 1, MPI_UINT64_T, MPI_SUM, 0, work_comm);
 
+        // fraction of the compression time that was hidden behind I/O, summed over ranks
+        std::array<double, 3> pipeline_ms{io_ms.count(), compute_ms.count(), wait_ms.count()};
+        std::array<double, 3> global_pipeline_ms{0, 0, 0};
+        MPI_Reduce(pipeline_ms.data(), global_pipeline_ms.data(), pipeline_ms.size(), MPI_DOUBLE, MPI_SUM, 0,
+                   work_comm);
+
+        // compare the cost predicted by the cost model with the compression time observed on each rank
+        std::vector<double> rank_costs;
+        if (weighted) {
+          std::array<double, 2> local_cost{weighted->predicted_cost(), compute_ms.count()};
+          if (work_rank == 0) rank_costs.resize(2 * work_size);
+          MPI_Gather(local_cost.data(), local_cost.size(), MPI_DOUBLE, rank_costs.data(), local_cost.size(),
+                     MPI_DOUBLE, 0, work_comm);
+        }
+
         // compute global compression ratio
         if (work_rank == 0) {
           auto end = std::chrono::steady_clock::now();
@@ -428,6 +1351,7 @@ int main(int argc, char* argv[]) {
           std::cout << "global_cr=" << global_total_size / static_cast<double>(global_compressed_size)
                     << std::endl;
           std::cout << "wallclock_ms=" << wallclock_ms << std::endl;
+          std::cout << "io_profile=" << args.io.json << std::endl;
           std::cout << "compress_ms=" << global_compress_ms << std::endl;
           std::cout << "compress_bandwidth_GBps="
                     << global_total_size / static_cast<double>(global_compress_ms) * 1e-6 << std::endl;
@@ -436,8 +1360,114 @@ int main(int argc, char* argv[]) {
           if (!args.output_file.empty()) {
             std::cout << "decompress_bandwidth_GBps="
                       << global_total_size / static_cast<double>(global_decompress_ms) * 1e-6 << std::endl;
+            std::cout << "flush_policy=" << args.flush.name() << std::endl;
+            std::cout << "flush_count=" << flush_count << std::endl;
+            std::cout << "flush_ms=" << longest_flush_ms << std::endl;
+          }
+          std::cout << "peak_bytes_dense=" << global_peak_counts[0] << std::endl;
+          std::cout << "peak_bytes_read=" << global_peak_counts[1] << std::endl;
+          std::cout << "centers_clamped=" << global_peak_counts[2] << std::endl;
+          std::cout << "centers_dropped=" << global_peak_counts[3] << std::endl;
+          if (archive) {
+            std::cout << "archive_bytes=" << archive->size_in_bytes() << std::endl;
+            std::cout << "archive_entries=" << archive->num_entries() << std::endl;
+          }
+          std::cout << "data_layout=" << (data_layout.chunked ? "chunked" : "contiguous") << std::endl;
+          std::cout << "chunk_events=" << chunk_events << std::endl;
+          std::cout << "direct_chunk_reads=" << global_direct_chunk_reads << std::endl;
+          std::cout << "compress_threads=" << args.compress_threads << std::endl;
+          std::cout << "predicted_rank_bytes=" << largest_rank_bytes[0] << std::endl;
+          std::cout << "peak_rss_bytes=" << largest_rank_bytes[1] << std::endl;
+          std::cout << "raw_reads=" << (raw_reader ? raw_frame_reader::mode_name(*args.raw_reads) : "none") << std::endl;
+          if (aggregator) {
+            std::cout << "write_aggregators=" << aggregator->num_aggregators() << std::endl;
+            std::cout << "aggregated_writes=" << global_aggregated_counts[0] << std::endl;
+            std::cout << "bytes_per_write="
+                      << (global_aggregated_counts[0] ? global_aggregated_counts[1] / global_aggregated_counts[0] : 0)
+                      << std::endl;
+            // the aggregators write concurrently, so the bandwidth is over the slowest aggregator's write time
+            std::cout << "aggregated_write_bandwidth_GBps="
+                      << (longest_aggregated_write_seconds > 0
+                              ? global_aggregated_counts[1] / longest_aggregated_write_seconds * 1e-9
+                              : 0)
+                      << std::endl;
+          }
+          if (filtered_writer) {
+            std::cout << "filtered_writes=" << global_filtered_counts[0] << std::endl;
+            std::cout << "filtered_bytes=" << global_filtered_counts[1] << std::endl;
+            std::cout << "filtered_write_ms=" << global_filtered_seconds[0] * 1e3 << std::endl;
+            std::cout << "filtered_finish_wait_ms=" << global_filtered_seconds[1] * 1e3 << std::endl;
+          }
+          if (adaptive) {
+            std::cout << "adaptive_chunk_changes=" << global_adaptive_counts[0] << std::endl;
+            std::cout << "adaptive_final_chunk_size=" << global_adaptive_counts[1] << std::endl;
+          }
+          if (args.reader_slots) {
+            std::cout << "reader_ranks=" << global_readers << std::endl;
+            std::cout << "reader_wait_ms=" << longest_reader_wait_ms << std::endl;
+          }
+          std::cout << "pool_bytes_allocated=" << global_pool_counts[0] << std::endl;
+          std::cout << "pool_bytes_reused=" << global_pool_counts[1] << std::endl;
+          std::cout << "pool_compressed_buffers_replaced=" << global_pool_counts[2] << std::endl;
+          if (weighted) {
+            // imbalance is the ratio of the most expensive rank to the mean of all ranks
+            auto imbalance = [&](size_t offset) {
+              double max_cost = 0, sum_cost = 0;
+              for (int r = 0; r < work_size; ++r) {
+                max_cost = std::max(max_cost, rank_costs[2 * r + offset]);
+                sum_cost += rank_costs[2 * r + offset];
+              }
+              return sum_cost > 0 ? max_cost / (sum_cost / work_size) : 1.0;
+            };
+            for (int r = 0; r < work_size; ++r) {
+              std::cout << "rank_cost rank=" << r << " predicted_cost=" << rank_costs[2 * r]
+                        << " observed_compute_ms=" << rank_costs[2 * r + 1] << std::endl;
+            }
+            std::cout << "predicted_imbalance=" << imbalance(0) << std::endl;
+            std::cout << "observed_imbalance=" << imbalance(1) << std::endl;
+          }
+          if (depth > 1) {
+            auto const [global_io_ms, global_compute_ms, global_wait_ms] = global_pipeline_ms;
+            std::cout << "pipeline_depth=" << depth << std::endl;
+            std::cout << "pipeline_io_ms=" << global_io_ms / work_size << std::endl;
+            std::cout << "pipeline_compute_ms=" << global_compute_ms / work_size << std::endl;
+            std::cout << "pipeline_wait_ms=" << global_wait_ms / work_size << std::endl;
+            std::cout << "pipeline_overlap="
+                      << (global_compute_ms > 0 ? 1.0 - global_wait_ms / global_compute_ms : 0.0)
+                      << std::endl;
+          }
+        }
+
+        if (args.decompress_repeats) {
+          // the bandwidth of a repetition is the bytes decompressed by all ranks over the slowest rank's time
+          auto const repeat_ms = time_decompress(comp, kept, args.decompress_repeats, work_comm);
+          std::vector<double> longest_repeat_ms(repeat_ms.size());
+          MPI_Reduce(repeat_ms.data(), longest_repeat_ms.data(), repeat_ms.size(), MPI_DOUBLE, MPI_MAX, 0,
+                     work_comm);
+          if (work_rank == 0) {
+            auto const [min_ms, max_ms] = std::minmax_element(longest_repeat_ms.begin(), longest_repeat_ms.end());
+            double const mean_ms =
+                std::accumulate(longest_repeat_ms.begin(), longest_repeat_ms.end(), 0.0) / longest_repeat_ms.size();
+            double variance = 0;
+            for (auto ms : longest_repeat_ms) variance += (ms - mean_ms) * (ms - mean_ms);
+            double const stddev_ms = std::sqrt(variance / longest_repeat_ms.size());
+            auto bandwidth = [&](double ms) { return global_total_size / ms * 1e-6; };
+            std::cout << "decompress_repeats=" << args.decompress_repeats << std::endl;
+            std::cout << "decompress_repeat_ms_mean=" << mean_ms << std::endl;
+            std::cout << "decompress_repeat_ms_min=" << *min_ms << std::endl;
+            std::cout << "decompress_repeat_ms_max=" << *max_ms << std::endl;
+            std::cout << "decompress_repeat_ms_stddev=" << stddev_ms << std::endl;
+            std::cout << "decompress_repeat_bandwidth_GBps_mean=" << bandwidth(mean_ms) << std::endl;
+            std::cout << "decompress_repeat_bandwidth_GBps_max=" << bandwidth(*min_ms) << std::endl;
+            std::cout << "decompress_repeat_bandwidth_GBps_min=" << bandwidth(*max_ms) << std::endl;
           }
         }
+
+        // written after the summary so that gathering the trace does not count towards the wallclock
+        if (trace.enabled()) {
+          if (trace.dropped()) logger("trace dropped ", trace.dropped(), " events");
+          trace.dump(args.trace_file, work_comm);
+        }
       } catch (std::exception const& ex) {
         std::cout << "rank " << work_rank << " " << ex.what() << std::endl;
         MPI_Abort(MPI_COMM_WORLD, 1);
@@ -447,6 +1477,62 @@ int main(int argc, char* argv[]) {
       logger(ex.what());
       MPI_Abort(MPI_COMM_WORLD, 1);
     }
+  } else if (node_has_readers) {
+    try {
+      // the workers decide whether the ring is used and broadcast its shape
+      reader_ring ring(reader_ring::shape{}, node_workers, per_node_comm);
+      if (ring.enabled()) {
+        // readers do not coordinate with each other, so each opens the file on its own and reads independently
+        hid_t fapl = check_hdf5(H5Pcreate(H5P_FILE_ACCESS));
+        cleanup cleanup_fapl([&] { H5Pclose(fapl); });
+        args.io.apply(fapl, MPI_COMM_SELF);
+        hid_t cxi = check_hdf5(H5Fopen(args.cxi_filename.c_str(), H5F_ACC_RDONLY, fapl));
+        cleanup cleanup_cxi([&] { H5Fclose(cxi); });
+        auto data = open_dset(cxi, "/entry_1/data_1/data");
+        auto posx = open_dset(cxi, "/entry_1/result_1/peakXPosRaw");
+        auto posy = open_dset(cxi, "/entry_1/result_1/peakYPosRaw");
+        auto npeaks = open_dset(cxi, "/entry_1/result_1/nPeaks");
+        h5transfer npeaks_io(npeaks, H5FD_MPIO_INDEPENDENT), posx_io(posx, H5FD_MPIO_INDEPENDENT),
+            posy_io(posy, H5FD_MPIO_INDEPENDENT), data_io(data, H5FD_MPIO_INDEPENDENT);
+
+        auto const data_layout = get_layout(data);
+        bool const direct_reads = args.direct_chunks && data_layout.chunked && data_layout.filters == 0;
+        std::unique_ptr<raw_frame_reader> raw_reader;
+        if (args.raw_reads) {
+          raw_reader = raw_frame_reader::open(args.cxi_filename, data, *args.raw_reads);
+        }
+        auto const data_lp_size = data.get_pressio_dims();
+        size_t const max_peaks = posx.get_dims_hsize().back();
+
+        ring.serve([&](ring_slot& slot) {
+          size_t const id = slot.id;
+          size_t const items = slot.work_items;
+          if (!items) return;
+          auto npeaks_data = pressio_data::nonowning(pressio_int64_dtype, slot.npeaks, {items});
+          npeaks_io.read({id}, {items}, npeaks_data, items);
+          auto posx_data = pressio_data::nonowning(pressio_double_dtype, slot.posx, {max_peaks, items});
+          posx_io.read({id, 0}, {items, max_peaks}, posx_data, items);
+          auto posy_data = pressio_data::nonowning(pressio_double_dtype, slot.posy, {max_peaks, items});
+          posy_io.read({id, 0}, {items, max_peaks}, posy_data, items);
+
+          std::vector<size_t> const frames_dims{data_lp_size.at(0), data_lp_size.at(1), items};
+          auto frames = pressio_data::nonowning(pressio_float_dtype, slot.frames, frames_dims);
+          if (raw_reader) {
+            // mmap hands out a view of the file rather than filling the slot
+            auto view = pressio_data::nonowning(pressio_float_dtype, slot.frames, frames_dims);
+            raw_reader->read(id, items, view);
+            if (view.data() != frames.data()) {
+              std::memcpy(frames.data(), view.data(), frames.size_in_bytes());
+            }
+          } else if (!(direct_reads && read_chunks_direct(data, data_layout, id, items, frames))) {
+            data_io.read({id, 0, 0}, {items, data_lp_size.at(1), data_lp_size.at(0)}, frames, items);
+          }
+        });
+      }
+    } catch (std::exception const& ex) {
+      logger("reader failed: ", ex.what());
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
   }
 
   return 0;
@@ -1,10 +1,11 @@
-#include <fcntl.h>
-#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include "file_helpers.h"
 
 std::string basename(std::string const& base) {
   auto last_slash = base.rfind('/');
@@ -24,13 +25,16 @@ std::string basename(std::string const& base) {
 struct args {
   std::string cxi_filename;
   std::string output_dir;
+  std::vector<copy_strategy> strategies;
+  unsigned threads = 1;
+  bool keep = false;
 };
 
 args parse_args(int argc, char* argv[]) {
   args args;
 
   int opt;
-  while ((opt = getopt(argc, argv, "f:o:")) != -1) {
+  while ((opt = getopt(argc, argv, "f:ho:ks:t:")) != -1) {
     switch (opt) {
       case 'f':
         args.cxi_filename = optarg;
@@ -38,50 +42,68 @@ args parse_args(int argc, char* argv[]) {
       case 'o':
         args.output_dir = optarg;
         break;
+      case 'k':
+        args.keep = true;
+        break;
+      case 's':
+        args.strategies.push_back(parse_copy_strategy(optarg));
+        break;
+      case 't':
+        args.threads = atoi(optarg);
+        if (args.threads == 0) {
+          throw std::runtime_error(std::string("invalid threads ") + optarg);
+        }
+        break;
       case 'h':
-        std::cout << "test the use of sendfile" << std::endl;
+        std::cout << "compare strategies for copying a file" << std::endl;
         std::cout << "-f <input_file>" << std::endl;
         std::cout << "-o <output_dir>" << std::endl;
+        std::cout << "-s <strategy> auto, reflink, copy_file_range, or sendfile; may be repeated (default: all)"
+                  << std::endl;
+        std::cout << "-t <threads> threads used by copy_file_range and sendfile (default: 1)" << std::endl;
+        std::cout << "-k keep the copy made by the last strategy" << std::endl;
         exit(0);
     }
   }
-
-  return args;
-}
-
-template <class T>
-T check_impl(T ret, const char* func, const char* file, int line) {
-  if (ret < 0) {
-    std::string msg = file;
-    msg += ":";
-    msg += std::to_string(line);
-    msg += " ";
-    msg += func;
-
-    perror(msg.c_str());
+  if (args.cxi_filename.empty()) {
+    std::cout << "input file is required" << std::endl;
+    exit(1);
+  }
+  // the copy is written to and unlinked from output_dir, so it has no default
+  if (args.output_dir.empty()) {
+    std::cout << "output directory is required" << std::endl;
     exit(1);
   }
-  return ret;
+  if (args.strategies.empty()) {
+    args.strategies = {copy_strategy::reflink, copy_strategy::copy_file_range, copy_strategy::sendfile};
+  }
+
+  return args;
 }
-#define check(...) check_impl((__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
 
 int main(int argc, char* argv[]) {
   args args = parse_args(argc, argv);
   std::string write_path = args.output_dir + '/' + basename(args.cxi_filename);
-  struct stat s;
-  int fd = check(open(args.cxi_filename.c_str(), O_RDONLY));
-  check(fstat(fd, &s));
-
-  int dest = check(open(write_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR));
-  ftruncate(dest, s.st_size);
-
-  off_t offset = 0;
-  while (offset < s.st_size) {
-    auto written = sendfile(dest, fd, &offset, s.st_size - offset);
-    std::cout << "wrote " << written << " bytes" << std::endl;
+  // the copy is unlinked after every strategy, which would remove the input if it is the same file
+  struct stat input, output;
+  if (stat(args.cxi_filename.c_str(), &input) == 0 && stat(write_path.c_str(), &output) == 0 &&
+      input.st_dev == output.st_dev && input.st_ino == output.st_ino) {
+    std::cout << "the copy " << write_path << " would replace the input file" << std::endl;
+    exit(1);
   }
-  fsync(dest);
 
-  close(fd);
-  close(dest);
+  for (auto strategy : args.strategies) {
+    try {
+      auto stats = copy_file(args.cxi_filename, write_path, strategy, args.threads);
+      std::cout << "strategy=" << copy_strategy_name(strategy) << " used=" << copy_strategy_name(stats.strategy)
+                << " threads=" << args.threads << " bytes=" << stats.bytes << " seconds=" << stats.seconds
+                << " GBps=" << stats.bandwidth_GBps() << std::endl;
+    } catch (std::exception const& ex) {
+      std::cout << "strategy=" << copy_strategy_name(strategy) << " failed: " << ex.what() << std::endl;
+    }
+    // start every strategy from an empty destination
+    if (!args.keep || strategy != args.strategies.back()) {
+      unlink(write_path.c_str());
+    }
+  }
 }
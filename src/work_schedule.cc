@@ -0,0 +1,145 @@
+#include "work_schedule.h"
+
+#include <algorithm>
+
+static_schedule::static_schedule(size_t num_events, size_t chunk_size, MPI_Comm comm)
+    : num_events(num_events), chunk_size(chunk_size) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  step_size = chunk_size * size;
+  rank_offset = chunk_size * rank;
+}
+
+bool static_schedule::next(work_range& range) {
+  if (i >= num_events) return false;
+  range.id = i + rank_offset;
+  if (range.id > num_events) {
+    range.work_items = 0;
+  } else if (range.id + chunk_size > num_events) {
+    range.work_items = num_events - range.id;
+  } else {
+    range.work_items = chunk_size;
+  }
+  i += step_size;
+  return true;
+}
+
+dynamic_schedule::dynamic_schedule(size_t num_events, size_t chunk_size, MPI_Comm comm)
+    : num_events(num_events), chunk_size(chunk_size) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Aint win_size = (rank == 0) ? sizeof(uint64_t) : 0;
+  MPI_Win_allocate(win_size, sizeof(uint64_t), MPI_INFO_NULL, comm, &counter, &win);
+  if (rank == 0) *counter = 0;
+  MPI_Barrier(comm);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+}
+
+dynamic_schedule::~dynamic_schedule() {
+  MPI_Win_unlock_all(win);
+  MPI_Win_free(&win);
+}
+
+bool dynamic_schedule::next(work_range& range) { return claim(chunk_size, range); }
+
+bool dynamic_schedule::claim(size_t count, work_range& range) {
+  uint64_t increment = count;
+  uint64_t start;
+  MPI_Fetch_and_op(&increment, &start, MPI_UINT64_T, /*target*/ 0, /*disp*/ 0, MPI_SUM, win);
+  MPI_Win_flush(0, win);
+  if (start >= num_events) return false;
+  range.id = start;
+  range.work_items = std::min<size_t>(count, num_events - start);
+  return true;
+}
+
+adaptive_schedule::adaptive_schedule(size_t num_events, size_t min_chunk, size_t max_chunk, MPI_Comm comm,
+                                     double tolerance)
+    : dynamic_schedule(num_events, min_chunk, comm),
+      min_chunk(min_chunk),
+      max_chunk(std::max(min_chunk, max_chunk / min_chunk * min_chunk)),
+      current(min_chunk),
+      tolerance(tolerance) {
+  history.push_back({0, current, 0});
+}
+
+bool adaptive_schedule::next(work_range& range) {
+  if (!started) {
+    started = true;
+    last = std::chrono::steady_clock::now();
+  }
+  return claim(current, range);
+}
+
+void adaptive_schedule::observe(size_t id, size_t bytes) {
+  auto const now = std::chrono::steady_clock::now();
+  double const seconds = std::chrono::duration<double>(now - last).count();
+  last = now;
+  if (seconds <= 0) return;
+  double const rate = bytes / seconds * 1e-9;
+  bool const first = previous_rate == 0;
+  bool const worse = rate < previous_rate * (1 - tolerance);
+  bool const better = rate > previous_rate * (1 + tolerance);
+  previous_rate = rate;
+  if (!first && !better && !worse) return;
+  if (worse) direction = -direction;
+
+  size_t const next = direction > 0 ? std::min(max_chunk, current * 2)
+                                    : std::max(min_chunk, current / 2 / min_chunk * min_chunk);
+  if (next == current) return;
+  current = next;
+  history.push_back({id, current, rate});
+}
+
+std::vector<size_t> partition_by_cost(std::vector<int64_t> const& npeaks, cost_model const& model,
+                                      size_t parts, size_t alignment) {
+  std::vector<double> prefix_cost(npeaks.size() + 1, 0.0);
+  for (size_t e = 0; e < npeaks.size(); ++e) {
+    prefix_cost[e + 1] = prefix_cost[e] + model(npeaks[e]);
+  }
+
+  // part p starts at the first event whose prefix cost reaches p/parts of the total
+  std::vector<size_t> boundaries(parts + 1, npeaks.size());
+  boundaries.front() = 0;
+  double const total_cost = prefix_cost.back();
+  for (size_t p = 1; p < parts; ++p) {
+    double const target = total_cost * static_cast<double>(p) / static_cast<double>(parts);
+    auto it = std::lower_bound(prefix_cost.begin(), prefix_cost.end(), target);
+    size_t boundary = static_cast<size_t>(it - prefix_cost.begin());
+    if (alignment > 1) {
+      boundary = std::min(npeaks.size(), (boundary + alignment / 2) / alignment * alignment);
+    }
+    boundaries[p] = std::max(boundaries[p - 1], boundary);
+  }
+  return boundaries;
+}
+
+weighted_schedule::weighted_schedule(std::vector<int64_t> const& npeaks, cost_model const& model,
+                                     size_t chunk_size, MPI_Comm comm, size_t alignment)
+    : chunk_size(chunk_size) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  auto boundaries = partition_by_cost(npeaks, model, size, alignment);
+  first = boundaries[rank];
+  last = boundaries[rank + 1];
+  i = first;
+  for (size_t e = first; e < last; ++e) {
+    cost += model(npeaks[e]);
+  }
+
+  uint64_t local_steps = (last - first + chunk_size - 1) / chunk_size;
+  uint64_t max_steps = 0;
+  MPI_Allreduce(&local_steps, &max_steps, 1, MPI_UINT64_T, MPI_MAX, comm);
+  steps = max_steps;
+}
+
+bool weighted_schedule::next(work_range& range) {
+  if (step >= steps) return false;
+  ++step;
+  range.id = i;
+  range.work_items = std::min(chunk_size, last - i);
+  i += range.work_items;
+  return true;
+}
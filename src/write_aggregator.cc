@@ -0,0 +1,178 @@
+#include "write_aggregator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+constexpr int header_tag = 2201;
+constexpr int frames_tag = 2202;
+constexpr uint64_t done_marker = std::numeric_limits<uint64_t>::max();
+}  // namespace
+
+write_aggregator::write_aggregator(h5dset const& dset, bool aggregator, size_t buffer_bytes, buffer_pool& pool,
+                                   MPI_Comm comm)
+    : dset(&dset), output(dset, H5FD_MPIO_INDEPENDENT), buffer_bytes(buffer_bytes), pool(&pool), comm(comm) {
+  auto const dims = dset.get_dims_hsize();
+  num_events = dims.front();
+  frame_dims.assign(std::next(dims.begin()), dims.end());
+  frame_bytes = std::accumulate(frame_dims.begin(), frame_dims.end(), pressio_dtype_size(dset.get_pressio_dtype()),
+                                std::multiplies<>{});
+  MPI_Type_contiguous(static_cast<int>(frame_bytes), MPI_BYTE, &frame_type);
+  MPI_Type_commit(&frame_type);
+
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  std::vector<int> flags(size);
+  int const flag = aggregator;
+  MPI_Allgather(&flag, 1, MPI_INT, flags.data(), 1, MPI_INT, comm);
+  for (int r = 0; r < size; ++r) {
+    if (flags[r]) {
+      if (r == rank) aggregator_index = aggregators.size();
+      aggregators.push_back(r);
+    }
+  }
+  if (aggregators.empty()) {
+    throw std::runtime_error("write_aggregator needs at least one aggregator rank");
+  }
+  if (!aggregator) aggregator_index = aggregators.size();
+  done_header = {done_marker, 0};
+}
+
+write_aggregator::~write_aggregator() {
+  for (auto& pending : sends) {
+    MPI_Waitall(pending.requests.size(), pending.requests.data(), MPI_STATUSES_IGNORE);
+    if (pending.pooled) pool->release(pending.pooled);
+  }
+  MPI_Type_free(&frame_type);
+}
+
+void write_aggregator::send(size_t first_event, size_t events, pressio_data&& frames, void const* pooled) {
+  pending_send pending{{}, {}, std::move(frames), pooled};
+  // split the events at the boundaries of the aggregators' ranges
+  size_t const n = aggregators.size();
+  size_t const last_event = first_event + events;
+  pending.headers.reserve(2 * n);
+  pending.requests.reserve(2 * n);
+  for (size_t event = first_event; event < last_event;) {
+    size_t const owner = std::min(n - 1, event * n / num_events);
+    // the first event the next aggregator owns, rounded up like the owner computation above
+    size_t const owner_end = ((owner + 1) * num_events + n - 1) / n;
+    size_t const part_events = std::min(last_event, owner_end) - event;
+    pending.headers.insert(pending.headers.end(), {event, part_events});
+    event += part_events;
+  }
+  auto const* bytes = static_cast<char const*>(pending.frames.data());
+  for (size_t part = 0; part < pending.headers.size() / 2; ++part) {
+    uint64_t const event = pending.headers[2 * part];
+    uint64_t const part_events = pending.headers[2 * part + 1];
+    int const dest = aggregators[std::min(n - 1, event * n / num_events)];
+    pending.requests.emplace_back();
+    MPI_Isend(&pending.headers[2 * part], 2, MPI_UINT64_T, dest, header_tag, comm, &pending.requests.back());
+    pending.requests.emplace_back();
+    MPI_Isend(bytes + (event - first_event) * frame_bytes, static_cast<int>(part_events), frame_type, dest,
+              frames_tag, comm, &pending.requests.back());
+  }
+  sends.push_back(std::move(pending));
+  progress();
+}
+
+bool write_aggregator::receive(bool wait) {
+  MPI_Status status;
+  int flag = 1;
+  if (wait) {
+    MPI_Probe(MPI_ANY_SOURCE, header_tag, comm, &status);
+  } else {
+    MPI_Iprobe(MPI_ANY_SOURCE, header_tag, comm, &flag, &status);
+  }
+  if (!flag) return false;
+  uint64_t header[2];
+  MPI_Recv(header, 2, MPI_UINT64_T, status.MPI_SOURCE, header_tag, comm, MPI_STATUS_IGNORE);
+  if (header[0] == done_marker) {
+    ++senders_done;
+    return true;
+  }
+  // messages from one rank are not overtaken, so these are the frames announced by the header
+  auto& frames = staged[header[0]];
+  frames.resize(header[1] * frame_bytes);
+  MPI_Recv(frames.data(), static_cast<int>(header[1]), frame_type, status.MPI_SOURCE, frames_tag, comm,
+           MPI_STATUS_IGNORE);
+  staged_bytes += frames.size();
+  return true;
+}
+
+void write_aggregator::progress() {
+  for (auto it = sends.begin(); it != sends.end();) {
+    int complete = 0;
+    MPI_Testall(it->requests.size(), it->requests.data(), &complete, MPI_STATUSES_IGNORE);
+    if (!complete) break;
+    if (it->pooled) pool->release(it->pooled);
+    it = sends.erase(it);
+  }
+  if (!is_aggregator()) return;
+  while (receive(false)) {
+  }
+  if (staged_bytes >= buffer_bytes) write_staged();
+}
+
+void write_aggregator::write_staged() {
+  // write each run of contiguous events with one call, merging runs made of several messages
+  for (auto it = staged.begin(); it != staged.end();) {
+    size_t const first = it->first;
+    size_t events = it->second.size() / frame_bytes;
+    auto run_end = std::next(it);
+    while (run_end != staged.end() && run_end->first == first + events) {
+      events += run_end->second.size() / frame_bytes;
+      ++run_end;
+    }
+    char* run = it->second.data();
+    if (std::next(it) != run_end) {
+      merged.resize(events * frame_bytes);
+      size_t offset = 0;
+      for (auto part = it; part != run_end; ++part) {
+        std::memcpy(merged.data() + offset, part->second.data(), part->second.size());
+        offset += part->second.size();
+      }
+      run = merged.data();
+    }
+
+    std::vector<hsize_t> start{first};
+    std::vector<hsize_t> count{events};
+    start.insert(start.end(), frame_dims.size(), 0);
+    count.insert(count.end(), frame_dims.begin(), frame_dims.end());
+    std::vector<size_t> lp_dims(count.rbegin(), count.rend());
+    auto data = pressio_data::nonowning(dset->get_pressio_dtype(), run, lp_dims);
+    auto const begin = std::chrono::steady_clock::now();
+    output.write(start, count, data, events);
+    counters.write_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    ++counters.writes;
+    counters.bytes_written += events * frame_bytes;
+    it = staged.erase(it, run_end);
+  }
+  staged_bytes = 0;
+}
+
+void write_aggregator::finish() {
+  std::vector<MPI_Request> done_requests(aggregators.size());
+  for (size_t i = 0; i < aggregators.size(); ++i) {
+    MPI_Isend(done_header.data(), 2, MPI_UINT64_T, aggregators[i], header_tag, comm, &done_requests[i]);
+  }
+  if (is_aggregator()) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    while (senders_done < size) {
+      receive(true);
+    }
+    write_staged();
+  }
+  MPI_Waitall(done_requests.size(), done_requests.data(), MPI_STATUSES_IGNORE);
+  for (auto& pending : sends) {
+    MPI_Waitall(pending.requests.size(), pending.requests.data(), MPI_STATUSES_IGNORE);
+    if (pending.pooled) pool->release(pending.pooled);
+  }
+  sends.clear();
+}